@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../RaytracerChallenge/math.h"
+#include "../RaytracerChallenge/matrix.h"
+#include "../RaytracerChallenge/tuple.h"
+#include "../RaytracerChallenge/color.h"
+#include "../RaytracerChallenge/ray.h"
+#include "../RaytracerChallenge/shape.h"
+#include "../RaytracerChallenge/intersection.h"
+#include "../RaytracerChallenge/material.h"
+#include "../RaytracerChallenge/light.h"
+#include "../RaytracerChallenge/pattern.h"
+
+// Microbenchmarks of the hot kernels. Every kernel runs on a small pool of precomputed inputs so the compiler
+// can't fold it away, and returns a float that is summed into a volatile sink for the same reason.
+//
+// usage: Benchmarks [--filter text] [--repetitions n] [--min-time ms] [--json path]
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::string filter;
+	int repetitions = 10;
+	double minTime = 0.02;	// seconds per repetition
+	std::string json;
+};
+
+struct Result
+{
+	std::string name;
+	double mean;	// ns per op
+	double min;
+	double max;
+	double stddev;
+	unsigned long long opsPerRepetition;
+};
+
+static volatile float sink;
+
+static const unsigned int poolSize = 256;
+
+// Runs op in a loop of n iterations and returns the elapsed seconds. A template, so the call to op can be inlined
+// instead of costing an indirect call on kernels of a few ns.
+template<typename Op>
+static double timeBatch(const Op& op, unsigned long long n)
+{
+	float sum = 0.f;
+	auto start = Clock::now();
+	for (unsigned long long i = 0; i < n; i++)
+		sum += op((unsigned int)(i % poolSize));
+	auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	sink = sum;
+	return seconds;
+}
+
+template<typename Op>
+static Result run(const std::string& name, const Options& options, const Op& op)
+{
+	// warmup, also grows the batch until a single one takes minTime
+	unsigned long long n = 1;
+	while (timeBatch(op, n) < options.minTime && n < (1ull << 40))
+		n *= 2;
+
+	std::vector<double> samples;
+	for (int r = 0; r < options.repetitions; r++)
+		samples.push_back(timeBatch(op, n) * 1e9 / n);
+
+	Result result = { name, 0., samples.front(), samples.front(), 0., n };
+	for (auto s : samples)
+	{
+		result.mean += s;
+		result.min = std::min(result.min, s);
+		result.max = std::max(result.max, s);
+	}
+	result.mean /= samples.size();
+	for (auto s : samples)
+		result.stddev += (s - result.mean) * (s - result.mean);
+	result.stddev = sqrt(result.stddev / samples.size());
+
+	return result;
+}
+
+static void print(const Result& r)
+{
+	std::cout << std::left << std::setw(36) << r.name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << r.mean << std::setw(12) << r.min << std::setw(12) << r.max << std::setw(10) << r.stddev
+		<< std::setw(16) << std::setprecision(0) << 1e9 / r.mean << std::endl;
+}
+
+static std::string toJson(const std::vector<Result>& results)
+{
+	std::stringstream ss;
+	ss << "{ \"benchmarks\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto& r = results[i];
+		ss << "  { \"name\": \"" << r.name << "\", \"nsPerOp\": " << r.mean << ", \"minNsPerOp\": " << r.min << ", \"maxNsPerOp\": " << r.max
+			<< ", \"stddevNs\": " << r.stddev << ", \"opsPerSecond\": " << 1e9 / r.mean << ", \"opsPerRepetition\": " << r.opsPerRepetition << " }"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	ss << "] }" << std::endl;
+	return ss.str();
+}
+
+static bool parse(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && hasValue)
+			options.filter = argv[++i];
+		else if (strcmp(argv[i], "--repetitions") == 0 && hasValue)
+			options.repetitions = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--min-time") == 0 && hasValue)
+			options.minTime = atof(argv[++i]) / 1000.;
+		else if (strcmp(argv[i], "--json") == 0 && hasValue)
+			options.json = argv[++i];
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--filter text] [--repetitions n] [--min-time ms] [--json path]" << std::endl;
+		return 1;
+	}
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+	std::vector<Matrix<4, 4>> matrices;
+	std::vector<Tuple> points;
+	std::vector<Tuple> vectors;
+	std::vector<Ray> rays;
+	for (unsigned int i = 0; i < poolSize; i++)
+	{
+		matrices.push_back(translation(uniform(rng), uniform(rng), uniform(rng)) * rotationY(uniform(rng) * pi) * scaling(1.5f + uniform(rng)));
+		points.push_back(Tuple::point(uniform(rng), uniform(rng), uniform(rng)));
+		vectors.push_back(Tuple::vector(uniform(rng), uniform(rng), uniform(rng) + 2.f));
+		// from in front of the unit sphere towards it, some rays miss
+		auto origin = Tuple::point(uniform(rng), 2.f + uniform(rng), -5.f);
+		rays.push_back(Ray(origin, normalize(Tuple::point(uniform(rng), uniform(rng), 0) - origin)));
+	}
+
+	auto sphere = Sphere();
+	sphere.transform = scaling(1.2f);
+	auto glass = Sphere::glass();
+	auto plane = Plane();
+
+	auto sphereHits = std::vector<Intersections>();
+	auto glassHits = std::vector<Intersections>();
+	for (const auto& r : rays)
+	{
+		sphereHits.push_back(sphere.intersect(r));
+		auto xs = glass.intersect(r);
+		xs += plane.intersect(r);
+		glassHits.push_back(xs);
+	}
+
+	auto light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
+	auto material = Material();
+
+	auto stripes = StripePattern(Color(1, 1, 1), Color(0, 0, 0));
+	auto gradient = GradientPattern(Color(1, 1, 1), Color(0, 0, 0));
+	auto rings = RingPattern(Color(1, 1, 1), Color(0, 0, 0));
+	auto checkers = CheckersPattern(Color(1, 1, 1), Color(0, 0, 0));
+
+	std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(12) << "ns/op" << std::setw(12) << "min"
+		<< std::setw(12) << "max" << std::setw(10) << "stddev" << std::setw(16) << "ops/s" << std::endl;
+
+	std::vector<Result> results;
+	auto benchmark = [&](const std::string& name, const auto& op) {
+		if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+			return;
+
+		results.push_back(run(name, options, op));
+		print(results.back());
+	};
+
+	// reused by every iteration, so its storage is only allocated during warmup
+	auto merged = Intersections();
+
+	benchmark("inverse", [&](unsigned int i) { return inverse(matrices[i])._14; });
+	benchmark("matrix * tuple", [&](unsigned int i) { return (matrices[i] * points[i]).x; });
+	benchmark("normalize", [&](unsigned int i) { return normalize(vectors[i]).x; });
+	benchmark("Sphere::intersect", [&](unsigned int i) { return (float)sphere.intersect(rays[i]).count(); });
+	benchmark("Plane::intersect", [&](unsigned int i) { return (float)plane.intersect(rays[i]).count(); });
+	benchmark("Intersections::operator+=", [&](unsigned int i) {
+		merged.clear();
+		merged += sphereHits[i];
+		merged += glassHits[i];
+		return (float)merged.count();
+	});
+	benchmark("Intersection::prepare (opaque)", [&](unsigned int i) {
+		const auto& xs = sphereHits[i];
+		return xs.count() > 0 ? xs[0].prepare(rays[i], xs).point.x : 0.f;
+	});
+	benchmark("Intersection::prepare (glass)", [&](unsigned int i) {
+		const auto& xs = glassHits[i];
+		return xs.count() > 0 ? xs[0].prepare(rays[i], xs).n2 : 0.f;
+	});
+	benchmark("Material::lighting", [&](unsigned int i) {
+		return material.lighting(sphere, light, points[i], Tuple::vector(0, 0, -1), normalize(vectors[i]), false).r;
+	});
+	benchmark("StripePattern::colorAt", [&](unsigned int i) { return stripes.colorAt(points[i]).r; });
+	benchmark("GradientPattern::colorAt", [&](unsigned int i) { return gradient.colorAt(points[i]).r; });
+	benchmark("RingPattern::colorAt", [&](unsigned int i) { return rings.colorAt(points[i]).r; });
+	benchmark("CheckersPattern::colorAt", [&](unsigned int i) { return checkers.colorAt(points[i]).r; });
+
+	if (!options.json.empty())
+	{
+		std::ofstream file;
+		file.open(options.json);
+		file << toJson(results);
+	}
+
+	return 0;
+}
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../RaytracerChallenge/canvas.h"
+#include "../RaytracerChallenge/camera.h"
+#include "../RaytracerChallenge/scenes.h"
+#include "../RaytracerChallenge/wavefront.h"
+
+// End-to-end benchmark of the chapter scenes. Every scene is rendered at a small reference resolution and compared
+// with a stored image, then timed at a larger resolution for every thread count. The results are written one case
+// per line so a later run can be checked against them with --baseline. Peak memory is the high-water mark of the
+// whole process, it is reported once for the run.
+//
+// Every engine in --engines renders every scene: camera is Camera::render, wavefront the Wavefront renderer and sorted
+// the Wavefront renderer with secondary ray sorting, which also reports its speedup over the unsorted wavefront.
+//
+// usage: SceneBenchmarks [--filter text] [--size WxH] [--threads n,n,...] [--engines e,e,...] [--repetitions n]
+//                        [--references dir] [--update-references] [--tolerance t] [--output path] [--baseline path]
+//                        [--max-regression pct]
+//
+// Exits with 1 if an image differs from its reference by more than the tolerance, isn't bit-identical for every
+// thread count or a case got slower than the baseline by more than max-regression percent.
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::string filter;
+	unsigned int width = 320;
+	unsigned int height = 160;
+	std::vector<unsigned int> threads = { 1, 0 };
+	std::vector<std::string> engines = { "camera" };
+	int repetitions = 3;
+	std::string references = "references";
+	bool updateReferences = false;
+	float tolerance = 0.002f;	// mean absolute channel difference
+	std::string output = "scene_benchmarks.json";
+	std::string baseline;
+	double maxRegression = 10.;	// percent
+};
+
+struct SceneCase
+{
+	std::string name;
+	std::function<std::unique_ptr<Scene>()> create;
+};
+
+struct Result
+{
+	std::string name;
+	std::string scene;
+	std::string engine;
+	unsigned int width;
+	unsigned int height;
+	unsigned int threads;
+	double seconds;	// best of the repetitions
+	unsigned long long rays;
+	double raysPerSecond;
+	float imageError;
+	bool imageOk;
+	unsigned long long fingerprint;	// of the reference sized image
+	bool deterministic;	// same fingerprint as with the first thread count
+	double speedup;	// of sorted over wavefront with the same threads, 0 for other engines
+};
+
+static const unsigned int referenceWidth = 100;
+static const unsigned int referenceHeight = 50;
+
+static unsigned long long peakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024ull;
+#endif
+#endif
+}
+
+// mean absolute difference of the channels, rounded like the ppm stores them
+static float difference(const Canvas& a, const Canvas& b)
+{
+	if (a.width != b.width || a.height != b.height)
+		return 1.f;
+
+	auto quantize = [](float c) { return std::clamp(std::rintf(c * 255.f), 0.f, 255.f) / 255.f; };
+	double sum = 0.;
+	for (size_t y = 0; y < a.height; y++)
+	{
+		for (size_t x = 0; x < a.width; x++)
+		{
+			auto ca = a.at(x, y);
+			auto cb = b.at(x, y);
+			sum += fabs(quantize(ca.r) - quantize(cb.r)) + fabs(quantize(ca.g) - quantize(cb.g)) + fabs(quantize(ca.b) - quantize(cb.b));
+		}
+	}
+	return (float)(sum / (3. * a.width * a.height));
+}
+
+static std::string toJson(const Result& r)
+{
+	std::stringstream ss;
+	ss << "{ \"name\": \"" << r.name << "\", \"scene\": \"" << r.scene << "\", \"width\": " << r.width << ", \"height\": " << r.height
+		<< ", \"threads\": " << r.threads << ", \"seconds\": " << r.seconds << ", \"rays\": " << r.rays
+		<< ", \"raysPerSecond\": " << std::fixed << std::setprecision(0) << r.raysPerSecond << std::defaultfloat << std::setprecision(6)
+		<< ", \"imageError\": " << r.imageError
+		<< ", \"imageOk\": " << (r.imageOk ? "true" : "false") << ", \"fingerprint\": \"" << std::hex << r.fingerprint << std::dec
+		<< "\", \"deterministic\": " << (r.deterministic ? "true" : "false") << ", \"engine\": \"" << r.engine << "\"";
+	if (r.speedup > 0.)
+		ss << ", \"speedupVsUnsorted\": " << r.speedup;
+	ss << " }";
+	return ss.str();
+}
+
+// Reads the rays/s of every case from a file written by toJson, relies on its one case per line layout.
+static std::map<std::string, double> readBaseline(const std::string& path)
+{
+	std::map<std::string, double> baseline;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		auto name = line.find("\"name\": \"");
+		auto rate = line.find("\"raysPerSecond\": ");
+		if (name == std::string::npos || rate == std::string::npos)
+			continue;
+
+		name += strlen("\"name\": \"");
+		auto end = line.find('"', name);
+		baseline[line.substr(name, end - name)] = atof(line.c_str() + rate + strlen("\"raysPerSecond\": "));
+	}
+	return baseline;
+}
+
+static bool parseSize(const char* text, unsigned int& width, unsigned int& height)
+{
+	return sscanf(text, "%ux%u", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+static std::vector<std::string> parseList(const std::string& text)
+{
+	std::vector<std::string> items;
+	std::stringstream ss(text);
+	std::string item;
+	while (std::getline(ss, item, ','))
+		items.push_back(item);
+	return items;
+}
+
+static std::vector<unsigned int> parseThreads(const std::string& text)
+{
+	std::vector<unsigned int> threads;
+	for (const auto& item : parseList(text))
+		threads.push_back((unsigned int)atoi(item.c_str()));
+	return threads;
+}
+
+static bool isEngine(const std::string& engine)
+{
+	return engine == "camera" || engine == "wavefront" || engine == "sorted";
+}
+
+static RenderResult renderWith(const std::string& engine, const World& world, const Camera& camera)
+{
+	if (engine == "camera")
+		return camera.renderWithStats(world);
+
+	Wavefront wavefront;
+	wavefront.setSortSecondary(engine == "sorted");
+	return wavefront.renderWithStats(world, camera);
+}
+
+static bool parse(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && hasValue)
+			options.filter = argv[++i];
+		else if (strcmp(argv[i], "--size") == 0 && hasValue)
+		{
+			if (!parseSize(argv[++i], options.width, options.height))
+				return false;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+			options.threads = parseThreads(argv[++i]);
+		else if (strcmp(argv[i], "--engines") == 0 && hasValue)
+			options.engines = parseList(argv[++i]);
+		else if (strcmp(argv[i], "--repetitions") == 0 && hasValue)
+			options.repetitions = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--references") == 0 && hasValue)
+			options.references = argv[++i];
+		else if (strcmp(argv[i], "--update-references") == 0)
+			options.updateReferences = true;
+		else if (strcmp(argv[i], "--tolerance") == 0 && hasValue)
+			options.tolerance = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--output") == 0 && hasValue)
+			options.output = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+			options.baseline = argv[++i];
+		else if (strcmp(argv[i], "--max-regression") == 0 && hasValue)
+			options.maxRegression = atof(argv[++i]);
+		else
+			return false;
+	}
+	return !options.threads.empty() && !options.engines.empty() && std::all_of(options.engines.begin(), options.engines.end(), isEngine);
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--filter text] [--size WxH] [--threads n,n,...] [--engines e,e,...] [--repetitions n]" << std::endl
+			<< "       [--references dir] [--update-references] [--tolerance t] [--output path] [--baseline path] [--max-regression pct]" << std::endl
+			<< "a thread count of 0 uses one thread per hardware thread, engines are camera, wavefront and sorted" << std::endl;
+		return 1;
+	}
+
+	std::vector<SceneCase> scenes = {
+		{ "simpleWorld", Scene::simpleWorld },
+		{ "worldWithPlanes", Scene::worldWithPlanes },
+		{ "worldWithPatterns", Scene::worldWithPatterns },
+		{ "worldRefraction", Scene::worldRefraction },
+		{ "sphereGrid4", [] { return Scene::sphereGrid(4); } },
+		{ "sphereGrid8", [] { return Scene::sphereGrid(8); } },
+	};
+
+	std::map<std::string, double> baseline;
+	if (!options.baseline.empty())
+	{
+		baseline = readBaseline(options.baseline);
+		if (baseline.empty())
+			std::cerr << "warning: no cases found in baseline " << options.baseline << std::endl;
+	}
+
+	std::cout << std::left << std::setw(36) << "case" << std::right << std::setw(10) << "seconds" << std::setw(14) << "Mrays/s"
+		<< std::setw(12) << "image err" << std::setw(12) << "vs base" << std::endl;
+
+	std::vector<Result> results;
+	int failures = 0;
+	for (const auto& s : scenes)
+	{
+		if (!options.filter.empty() && s.name.find(options.filter) == std::string::npos)
+			continue;
+
+		auto scene = s.create();
+		auto referencePath = options.references + "/" + s.name + ".ppm";
+		if (options.updateReferences)
+		{
+			auto camera = scene->camera(referenceWidth, referenceHeight);
+			camera.render(scene->world).savePPM(referencePath);
+		}
+		auto reference = Canvas::loadPPM(referencePath);
+		if (reference.width == 0)
+			std::cerr << "missing reference " << referencePath << ", run with --update-references to create it" << std::endl;
+
+		std::map<std::string, unsigned long long> expectedFingerprints;
+		for (auto threads : options.threads)
+		{
+			double unsortedSeconds = 0.;
+			for (const auto& engine : options.engines)
+			{
+				// the image must not depend on the number of threads either, down to the last bit
+				auto check = scene->camera(referenceWidth, referenceHeight);
+				check.setThreads(threads);
+				auto image = renderWith(engine, scene->world, check).canvas;
+				auto error = difference(image, reference);
+				auto fingerprint = image.fingerprint();
+				if (threads == options.threads.front())
+					expectedFingerprints[engine] = fingerprint;
+
+				auto camera = scene->camera(options.width, options.height);
+				camera.setThreads(threads);
+				RenderStats best;
+				best.seconds = -1.;
+				for (int r = 0; r < options.repetitions; r++)
+				{
+					auto result = renderWith(engine, scene->world, camera);
+					if (best.seconds < 0. || result.stats.seconds < best.seconds)
+						best = result.stats;
+				}
+
+				Result result;
+				result.scene = s.name;
+				result.engine = engine;
+				result.width = options.width;
+				result.height = options.height;
+				result.threads = camera.getThreads();
+				result.name = s.name + "/" + std::to_string(options.width) + "x" + std::to_string(options.height) + "/t" + (threads == 0 ? "max" : std::to_string(threads))
+					+ (engine == "camera" ? "" : "/" + engine);
+				result.seconds = best.seconds;
+				result.rays = best.totalRays();
+				result.raysPerSecond = best.seconds > 0. ? best.totalRays() / best.seconds : 0.;
+				result.imageError = error;
+				result.imageOk = error <= options.tolerance;
+				result.fingerprint = fingerprint;
+				result.deterministic = fingerprint == expectedFingerprints[engine];
+				// sorted is compared with the unsorted wavefront if that ran before it
+				if (engine == "wavefront")
+					unsortedSeconds = best.seconds;
+				result.speedup = engine == "sorted" && unsortedSeconds > 0. && best.seconds > 0. ? unsortedSeconds / best.seconds : 0.;
+
+				std::string versus = "-";
+				bool regressed = false;
+				auto base = baseline.find(result.name);
+				if (base != baseline.end() && base->second > 0.)
+				{
+					auto change = (result.raysPerSecond / base->second - 1.) * 100.;
+					regressed = change < -options.maxRegression;
+					std::stringstream ss;
+					ss << std::showpos << std::fixed << std::setprecision(1) << change << "%";
+					versus = ss.str();
+				}
+
+				std::cout << std::left << std::setw(36) << result.name << std::right << std::fixed << std::setprecision(3)
+					<< std::setw(10) << result.seconds << std::setw(14) << result.raysPerSecond / 1e6
+					<< std::setw(12) << std::setprecision(5) << result.imageError << std::setw(12) << versus;
+				if (result.speedup > 0.)
+					std::cout << "  " << std::setprecision(2) << result.speedup << "x vs unsorted";
+				std::cout << (result.imageOk ? "" : "  IMAGE MISMATCH") << (result.deterministic ? "" : "  THREAD DEPENDENT")
+					<< (regressed ? "  REGRESSION" : "") << std::endl;
+
+				failures += (result.imageOk ? 0 : 1) + (result.deterministic ? 0 : 1) + (regressed ? 1 : 0);
+				results.push_back(result);
+			}
+		}
+	}
+
+	auto peak = peakMemory();
+	std::cout << "peak memory " << std::fixed << std::setprecision(1) << peak / (1024. * 1024.) << " MB" << std::endl;
+
+	if (!options.output.empty())
+	{
+		std::ofstream file(options.output);
+		file << "{ \"cases\": [" << std::endl;
+		for (size_t i = 0; i < results.size(); i++)
+			file << "  " << toJson(results[i]) << (i + 1 < results.size() ? "," : "") << std::endl;
+		file << "], \"peakMemoryBytes\": " << peak << ", \"failures\": " << failures << " }" << std::endl;
+	}
+
+	if (failures > 0)
+		std::cerr << failures << " failure(s)" << std::endl;
+	return failures > 0 ? 1 : 0;
+}
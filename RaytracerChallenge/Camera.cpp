@@ -1,10 +1,44 @@
 #include "camera.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
 #include "world.h"
+#include "trace.h"
 #include "color.h"
+#include "sampler.h"
+
+RenderBudget::RenderBudget()
+	: cancelled(false), hasDeadline(false)
+{
+}
+
+RenderBudget::RenderBudget(std::chrono::steady_clock::time_point deadline)
+	: cancelled(false), hasDeadline(true), deadline(deadline)
+{
+}
+
+RenderBudget::RenderBudget(std::chrono::steady_clock::duration budget)
+	: RenderBudget(std::chrono::steady_clock::now() + budget)
+{
+}
+
+void RenderBudget::cancel()
+{
+	cancelled = true;
+}
+
+bool RenderBudget::expired() const
+{
+	return cancelled.load(std::memory_order_relaxed) || (hasDeadline && std::chrono::steady_clock::now() >= deadline);
+}
 
 Camera::Camera(unsigned int width, unsigned int height, float fov)
-	: width(width), height(height), fov(fov), transform(Matrix<4, 4>::identity()), maxBounces(5)
+	: width(width), height(height), fov(fov), transform(Matrix<4, 4>::identity()), maxBounces(5), pixelCost(PixelCost::None), threads(1),
+	antialiasSamples(1), antialiasThreshold(0.1f), sampler(nullptr)
 {
 	float halfView = tanf(fov / 2.f);
 	float aspect = (float) width / height;
@@ -54,35 +88,389 @@ float Camera::getPixelSize() const
 
 Ray Camera::getRay(unsigned int x, unsigned int y) const
 {
-	// Offset from the edge of the canvas to the pixel's center
-	float xOffset = (x + 0.5f) * pixelSize;
-	float yOffset = (y + 0.5f) * pixelSize;
+	return getRay(x, y, 0.5f, 0.5f);
+}
+
+Ray Camera::getRay(unsigned int x, unsigned int y, float u, float v) const
+{
+	// Offset from the edge of the canvas to the sampled point of the pixel
+	float xOffset = (x + u) * pixelSize;
+	float yOffset = (y + v) * pixelSize;
 	// untranssformed coordinates of the pixel in world space.
 	float worldX = halfWidth - xOffset;
 	float worldY = halfHeight - yOffset;
 
-	auto invTransform = inverse(transform);
+	const auto& invTransform = transform.getInverse();
 	Tuple pixel = invTransform * Tuple::point(worldX, worldY, -1);
 	Tuple origin = invTransform * Tuple::point(0, 0, 0);
 	Tuple direction = normalize(pixel - origin);
 	return Ray(origin, direction);
 }
 
+void Camera::getRays(unsigned int first, unsigned int count, std::vector<Ray>& rays) const
+{
+	const auto& invTransform = transform.getInverse();
+	Tuple origin = invTransform * Tuple::point(0, 0, 0);
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		float xOffset = (i % width + 0.5f) * pixelSize;
+		float yOffset = (i / width + 0.5f) * pixelSize;
+		Tuple pixel = invTransform * Tuple::point(halfWidth - xOffset, halfHeight - yOffset, -1);
+		rays.push_back(Ray(origin, normalize(pixel - origin)));
+	}
+}
+
+bool Camera::project(const Tuple& point, float& x, float& y, float& depth) const
+{
+	auto p = transform * point;
+	if (p.z >= 0.f)
+		return false;
+
+	x = (halfWidth + p.x / p.z) / pixelSize;
+	y = (halfHeight + p.y / p.z) / pixelSize;
+	depth = point.w == 0.f ? INFINITY : -p.z;
+	return true;
+}
+
 Canvas Camera::render(const World& world) const
 {
 	Canvas c = Canvas(width, height);
+	renderFrame(world, frame(), c, 0, 0, nullptr);
+	return c;
+}
+
+Canvas Camera::renderRegion(const World& world, const Region& region) const
+{
+	auto clipped = clip(region);
+	Canvas c = Canvas(clipped.width, clipped.height);
+	renderFrame(world, clipped, c, -(int)clipped.x, -(int)clipped.y, nullptr);
+	return c;
+}
 
-	for(unsigned int y = 0; y < height; y++)
-		for (unsigned int x = 0; x < width; x++)
+void Camera::renderRegion(const World& world, const Region& region, Canvas& target, unsigned int targetX, unsigned int targetY) const
+{
+	auto clipped = clip(region);
+	renderFrame(world, clipped, target, (int)targetX - (int)clipped.x, (int)targetY - (int)clipped.y, nullptr);
+}
+
+Canvas Camera::renderProgressive(const World& world, const ProgressCallback& callback, unsigned int blockSize) const
+{
+	RenderBudget unlimited;
+	return renderWithin(world, unlimited, callback, blockSize).canvas;
+}
+
+PartialRender Camera::renderWithin(const World& world, const RenderBudget& budget, const ProgressCallback& callback, unsigned int blockSize) const
+{
+	unsigned int step = 1;
+	unsigned int passes = 1;
+	while (step < blockSize)
+	{
+		step *= 2;
+		passes++;
+	}
+
+	Canvas c = Canvas(width, height);
+	bool antialias = antialiasSamples >= 4;
+	// every pixel is traced by exactly one pass, so the hits are complete after the last one
+	std::vector<const Shape*> hits(antialias ? width * height : 0);
+	unsigned long long traced = 0;
+	for (unsigned int pass = 0; pass < passes && !budget.expired(); pass++, step /= 2)
+	{
+		RenderJob job = { c, nullptr, { step, pass > 0 }, &budget, frame(), 0, 0, antialias ? hits.data() : nullptr };
+		traced += render(world, job);
+		if (budget.expired())
+			break;
+		if (antialias && pass + 1 == passes)
 		{
-			auto ray = getRay(x, y);
-			auto color = world.colorAt(ray, maxBounces);
-			c.writePixel(x, y, color);
+			// the traced frame holds the centers renderFrame traces, resampling them gives the image of render
+			TRACE_SCOPE("antialias");
+			auto centers = c;
+			RenderJob resample = { c, nullptr, { 1, false }, nullptr, frame(), 0, 0 };
+			runWorkers([&]() { antialiasRows(world, resample, centers, hits, frame()); });
 		}
-	return c;
+		if (callback)
+			callback(c, pass, passes);
+	}
+
+	auto total = (unsigned long long)width * height;
+	return { c, traced >= total ? 1.f : (float)traced / total };
+}
+
+Region Camera::frame() const
+{
+	return { 0, 0, width, height };
+}
+
+Region Camera::clip(const Region& region) const
+{
+	unsigned int x = std::min(region.x, width);
+	unsigned int y = std::min(region.y, height);
+	return { x, y, std::min(region.width, width - x), std::min(region.height, height - y) };
+}
+
+void Camera::renderFrame(const World& world, const Region& region, Canvas& image, int offsetX, int offsetY, Canvas* cost) const
+{
+	if (antialiasSamples < 4)
+	{
+		RenderJob job = { image, cost, { 1, false }, nullptr, region, offsetX, offsetY };
+		render(world, job);
+		return;
+	}
+
+	// finding edges compares with the neighbors, so the centers of the pixels around the region are traced too
+	unsigned int left = region.x > 0 ? region.x - 1 : 0;
+	unsigned int top = region.y > 0 ? region.y - 1 : 0;
+	Region border = { left, top, std::min(region.x + region.width + 1, width) - left, std::min(region.y + region.height + 1, height) - top };
+
+	auto centers = Canvas(border.width, border.height);
+	std::vector<const Shape*> hits(border.width * border.height);
+	RenderJob job = { centers, cost, { 1, false }, nullptr, border, -(int)border.x, -(int)border.y, hits.data() };
+	render(world, job);
+
+	TRACE_SCOPE("antialias");
+	RenderJob resample = { image, cost, { 1, false }, nullptr, region, offsetX, offsetY };
+	runWorkers([&]() { antialiasRows(world, resample, centers, hits, border); });
+}
+
+unsigned long long Camera::render(const World& world, RenderJob& job) const
+{
+	TRACE_SCOPE("render");
+	runWorkers([&]() { renderRows(world, job); });
+	return job.tracedPixels;
+}
+
+void Camera::runWorkers(const std::function<void()>& work) const
+{
+	unsigned int count = getThreads();
+	if (count <= 1)
+	{
+		work();
+		return;
+	}
+
+	// every worker counts into its own stats, they are merged once all rows are done
+	auto stats = RenderStats::active();
+	std::vector<RenderStats> workerStats(count);
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		workers.emplace_back([&, i]() {
+			Trace::setWorker(i);
+			if (stats != nullptr)
+				RenderStats::setActive(&workerStats[i]);
+			work();
+			RenderStats::setActive(nullptr);
+		});
+	}
+
+	for (auto& worker : workers)
+		worker.join();
+
+	if (stats != nullptr)
+	{
+		for (const auto& s : workerStats)
+			stats->merge(s);
+	}
+}
+
+void Camera::renderRows(const World& world, RenderJob& job) const
+{
+	auto stats = RenderStats::active();
+	auto& image = job.image;
+	auto cost = job.cost;
+	const auto& region = job.region;
+	const unsigned int step = job.pass.step;
+	const unsigned int right = region.x + region.width;
+	const unsigned int bottom = region.y + region.height;
+	unsigned long long traced = 0;
+
+	for (unsigned int y = region.y + step * job.nextRow++; y < bottom; y = region.y + step * job.nextRow++)
+	{
+		TRACE_SCOPE("render row");
+		// the previous pass traced the even multiples of step on rows at multiples of 2 * step
+		bool tracedRow = job.pass.refine && (y - region.y) % (2 * step) == 0;
+		for (unsigned int x = region.x + (tracedRow ? step : 0); x < right; x += tracedRow ? 2 * step : step)
+		{
+			if (job.budget != nullptr && job.budget->expired())
+			{
+				job.tracedPixels += traced;
+				return;
+			}
+			traced++;
+
+			auto start = std::chrono::steady_clock::now();
+			auto rays = stats != nullptr ? stats->totalRays() : 0;
+
+			Ray ray;
+			{
+				StageTimer timer(RenderStats::Camera);
+				ray = getRay(x, y);
+			}
+			if (stats != nullptr)
+				stats->primaryRays++;
+
+			unsigned int ix = x + job.offsetX;
+			unsigned int iy = y + job.offsetY;
+			Sampler::setCurrent({ x, y, 0 });
+			auto color = world.colorAt(ray, maxBounces, job.hits != nullptr ? &job.hits[iy * image.width + ix] : nullptr);
+			for (unsigned int by = iy; by < iy + std::min(step, bottom - y); by++)
+				for (unsigned int bx = ix; bx < ix + std::min(step, right - x); bx++)
+					image.writePixel(bx, by, color);
+
+			if (cost == nullptr)
+				continue;
+			float value = pixelCost == PixelCost::Time
+				? std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count()
+				: (float)(stats->totalRays() - rays);
+			cost->writePixel(x, y, Color(value, value, value));
+		}
+	}
+	job.tracedPixels += traced;
+}
+
+// A pixel is resampled if a neighbor hit another object or differs in any channel by more than threshold.
+static bool isEdge(const Canvas& centers, const std::vector<const Shape*>& hits, unsigned int x, unsigned int y, float threshold)
+{
+	static const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+	const auto& color = centers.at(x, y);
+	auto hit = hits[y * centers.width + x];
+	for (const auto& offset : offsets)
+	{
+		unsigned int nx = x + offset[0];
+		unsigned int ny = y + offset[1];
+		if (nx >= centers.width || ny >= centers.height)
+			continue;
+
+		const auto& other = centers.at(nx, ny);
+		if (hits[ny * centers.width + nx] != hit || fabsf(color.r - other.r) > threshold || fabsf(color.g - other.g) > threshold
+			|| fabsf(color.b - other.b) > threshold)
+			return true;
+	}
+	return false;
+}
+
+void Camera::antialiasRows(const World& world, RenderJob& job, const Canvas& centers, const std::vector<const Shape*>& hits, const Region& border) const
+{
+	auto stats = RenderStats::active();
+	auto& image = job.image;
+	auto cost = job.cost;
+	const auto& region = job.region;
+	const auto& pixelSampler = sampler != nullptr ? *sampler : Sampler::regular();
+	unsigned int n = (unsigned int)sqrtf((float)antialiasSamples);
+	unsigned int count = n * n;
+	// the center is already traced, an odd regular grid has it as its middle sample
+	bool centerSample = n % 2 == 1 && dynamic_cast<const RegularSampler*>(&pixelSampler) != nullptr;
+
+	for (unsigned int y = region.y + job.nextRow++; y < region.y + region.height; y = region.y + job.nextRow++)
+	{
+		for (unsigned int x = region.x; x < region.x + region.width; x++)
+		{
+			unsigned int cx = x - border.x;
+			unsigned int cy = y - border.y;
+			if (!isEdge(centers, hits, cx, cy, antialiasThreshold))
+			{
+				image.writePixel(x + job.offsetX, y + job.offsetY, centers.at(cx, cy));
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			auto rays = stats != nullptr ? stats->totalRays() : 0;
+
+			auto sum = Color(0);
+			unsigned int extra = 0;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				auto sample = pixelSampler.get({ x, y, 0 }, Sampler::Pixel, i, count);
+				if (centerSample && i == count / 2)
+				{
+					sum = sum + centers.at(cx, cy);
+					continue;
+				}
+
+				Ray ray;
+				{
+					StageTimer timer(RenderStats::Camera);
+					ray = getRay(x, y, sample.u, sample.v);
+				}
+				Sampler::setCurrent({ x, y, i + 1 });
+				sum = sum + world.colorAt(ray, maxBounces);
+				extra++;
+			}
+			image.writePixel(x + job.offsetX, y + job.offsetY, sum * (1.f / count));
+
+			if (stats != nullptr)
+			{
+				stats->primaryRays += extra;
+				stats->antialiasedPixels++;
+				stats->antialiasingRays += extra;
+			}
+
+			if (cost == nullptr)
+				continue;
+			float value = pixelCost == PixelCost::Time
+				? std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count()
+				: (float)(stats->totalRays() - rays);
+			cost->writePixel(x, y, cost->at(x, y) + Color(value, value, value));
+		}
+	}
+}
+
+RenderResult Camera::renderWithStats(const World& world) const
+{
+	RenderStats stats;
+	RenderStats::setActive(&stats);
+
+	auto canvas = Canvas(width, height);
+	auto cost = pixelCost != PixelCost::None ? Canvas(width, height) : Canvas(0, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	renderFrame(world, frame(), canvas, 0, 0, pixelCost != PixelCost::None ? &cost : nullptr);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	RenderStats::setActive(nullptr);
+	return { canvas, stats, cost };
+}
+
+unsigned int Camera::getMaxBounces() const
+{
+	return maxBounces;
 }
 
 void Camera::setMaxBounces(unsigned int maxBounces)
 {
 	this->maxBounces = maxBounces;
+}
+
+void Camera::setPixelCost(PixelCost pixelCost)
+{
+	this->pixelCost = pixelCost;
+}
+
+unsigned int Camera::getThreads() const
+{
+	if (threads == 0)
+		return std::max(1u, std::thread::hardware_concurrency());
+	return threads;
+}
+
+void Camera::setThreads(unsigned int threads)
+{
+	this->threads = threads;
+}
+
+unsigned int Camera::getAntialiasSamples() const
+{
+	return antialiasSamples;
+}
+
+void Camera::setAntialiasing(unsigned int maxSamples, float threshold)
+{
+	antialiasSamples = maxSamples;
+	antialiasThreshold = threshold;
+}
+
+void Camera::setSampler(const Sampler* sampler)
+{
+	this->sampler = sampler;
 }
\ No newline at end of file
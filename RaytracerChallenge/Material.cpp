@@ -1,5 +1,6 @@
 #include "material.h"
 
+#include <cmath>
 #include <sstream>
 
 #include "math.h"
@@ -15,43 +16,58 @@ Material::Material()
 
 Color Material::lighting(const Shape& object, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal, const bool inShadow) const
 {
-	Color color;
-	if (pattern != nullptr)
-		color = pattern->colorAtShape(object, pos);
-	else
-		color = this->color;
+	auto terms = lightingTerms(object, light, pos, eye, normal);
+	if (inShadow)
+		return terms.ambient;
+
+	return terms.ambient + terms.direct;
+}
+
+LightingTerms Material::lightingTerms(const Shape& object, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal) const
+{
+	return lightingTerms(colorAt(object, pos), light, pos, eye, normal);
+}
+
+LightingTerms Material::lightingTerms(const Color& surfaceColor, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal) const
+{
 	// combine surface color with light color/intensity
-	const Color effectiveColor = color * light.intensity;
+	const Color effectiveColor = surfaceColor * light.intensity;
 	const Color ambientColor = effectiveColor * ambient;
 
-	if (inShadow)
-	{
-		return ambientColor;
-	}
-
 	// directon TO the light source
-	const Tuple l = normalize(light.position - pos);
+	Tuple l = light.position - pos;
+	const float distance = length(l);
+	l = l / distance;
 
 	const float lightDotNormal = dot(l, normal);
 
 	if (lightDotNormal < 0)	// light is on the other side
 	{
-		return ambientColor;
+		return { ambientColor, Color(0) };
 	}
 
+	const float attenuation = light.attenuation(distance);
+
 	Color diffuseColor = effectiveColor * diffuse * lightDotNormal;
 	// light reflection vector
 	Tuple r = reflect(-l, normal);
 	float rDotEye = dot(r, eye);
 
-	Color specularColor = Color();
+	Color specularColor = Color(0);
 	if (rDotEye > 0)
 	{
 		float factor = powf(rDotEye, shininess);
 		specularColor = light.intensity * specular * factor;
 	}
 
-	return ambientColor + diffuseColor + specularColor;
+	return { ambientColor, (diffuseColor + specularColor) * attenuation };
+}
+
+Color Material::colorAt(const Shape& object, const Tuple& pos) const
+{
+	if (pattern != nullptr)
+		return pattern->colorAtShape(object, pos);
+	return color;
 }
 
 bool Material::operator==(const Material& rhs) const
@@ -65,3 +81,157 @@ std::wstring ToString(const Material& m)
 	ss << "Material: Color" << ToString(m.color) << " ambient " << m.ambient << " diff " << m.diffuse << " spec " << m.specular << " shine " << m.shininess << std::endl;
 	return ss.str();
 }
+
+MaterialLibrary::MaterialLibrary()
+	: materials{ Material() }
+{
+}
+
+size_t MaterialLibrary::add(const Material& m)
+{
+	materials.push_back(m);
+	return materials.size() - 1;
+}
+
+size_t MaterialLibrary::count() const
+{
+	return materials.size();
+}
+
+const Material& MaterialLibrary::operator[](size_t index) const
+{
+	return materials[index];
+}
+
+Material& MaterialLibrary::operator[](size_t index)
+{
+	return materials[index];
+}
+
+MaterialRef::MaterialRef()
+	: library(nullptr), index(0), owned(std::make_unique<Material>()), shared(false)
+{
+}
+
+MaterialRef::MaterialRef(MaterialLibrary& library, size_t index)
+	: library(&library), index((unsigned int)index), owned(), shared(false)
+{
+}
+
+MaterialRef::MaterialRef(const MaterialRef& other)
+	: library(other.library), index(other.index), owned(other.owned != nullptr ? std::make_unique<Material>(*other.owned) : nullptr),
+	shared(other.library != nullptr)
+{
+	other.shared = shared || other.shared;
+}
+
+MaterialRef::MaterialRef(MaterialRef&& other) noexcept
+	: library(other.library), index(other.index), owned(std::move(other.owned)), shared(other.shared)
+{
+}
+
+MaterialRef& MaterialRef::operator=(const MaterialRef& other)
+{
+	if (this == &other)
+		return *this;
+
+	library = other.library;
+	index = other.index;
+	owned = other.owned != nullptr ? std::make_unique<Material>(*other.owned) : nullptr;
+	shared = library != nullptr;
+	other.shared = shared || other.shared;
+	return *this;
+}
+
+MaterialRef& MaterialRef::operator=(MaterialRef&& other) noexcept
+{
+	library = other.library;
+	index = other.index;
+	owned = std::move(other.owned);
+	shared = other.shared;
+	return *this;
+}
+
+MaterialRef& MaterialRef::operator=(const Material& m)
+{
+	if (owned != nullptr)
+	{
+		*owned = m;
+		return *this;
+	}
+	index = (unsigned int)library->add(m);
+	shared = false;
+	return *this;
+}
+
+void MaterialRef::moveTo(MaterialLibrary& target)
+{
+	if (library == &target)
+		return;
+
+	index = (unsigned int)target.add(owned != nullptr ? *owned : (*library)[index]);
+	library = &target;
+	owned.reset();
+	shared = false;
+}
+
+size_t MaterialRef::getIndex() const
+{
+	return index;
+}
+
+const MaterialLibrary* MaterialRef::getLibrary() const
+{
+	return library;
+}
+
+const Material& MaterialRef::get() const
+{
+	if (owned != nullptr)
+		return *owned;
+	return (*library)[index];
+}
+
+Material& MaterialRef::get()
+{
+	if (owned != nullptr)
+		return *owned;
+	if (shared)
+	{
+		index = (unsigned int)library->add((*library)[index]);
+		shared = false;
+	}
+	return (*library)[index];
+}
+
+const Material* MaterialRef::operator->() const
+{
+	return &get();
+}
+
+Material* MaterialRef::operator->()
+{
+	return &get();
+}
+
+const Material& MaterialRef::operator*() const
+{
+	return get();
+}
+
+Material& MaterialRef::operator*()
+{
+	return get();
+}
+
+MaterialRef::operator const Material&() const
+{
+	return get();
+}
+
+bool MaterialRef::operator==(const MaterialRef& rhs) const
+{
+	if (owned != nullptr || rhs.owned != nullptr)
+		return owned == rhs.owned;
+	return library == rhs.library && index == rhs.index;
+}
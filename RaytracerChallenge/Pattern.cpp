@@ -1,5 +1,7 @@
 #include "pattern.h"
 
+#include <cmath>
+
 #include "shape.h"
 
 Pattern::Pattern()
@@ -9,8 +11,8 @@ Pattern::Pattern()
 
 Color Pattern::colorAtShape(const Shape& shape, const Tuple& point) const
 {
-	auto objectPoint = inverse(shape.transform) * point;
-	auto patternPoint = inverse(transform) * objectPoint;
+	auto objectPoint = shape.transform.getInverse() * point;
+	auto patternPoint = transform.getInverse() * objectPoint;
 
 	return colorAt(patternPoint);
 }
@@ -1,12 +1,182 @@
 #include "world.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include "math.h"
 #include "intersection.h"
 #include "ray.h"
 #include "shape.h"
+#include "sampler.h"
+#include "stats.h"
+#include "trace.h"
+
+// Storage reused by every ray traced on a thread
+struct TraceScratch
+{
+    std::vector<PendingRay> rays;
+    Intersections xs;
+    Intersections shadowXs;
+};
+
+static TraceScratch& scratch()
+{
+    thread_local TraceScratch s;
+    return s;
+}
+
+thread_local RayLog* activeLog = nullptr;
+
+void RayLog::clear()
+{
+    hits.clear();
+    segments.clear();
+    misses.clear();
+}
+
+// the index of the entry of entries that grows the least when merged with added
+template<typename T, typename Growth>
+static size_t leastGrowth(const std::vector<T>& entries, const Growth& growth)
+{
+    size_t best = 0;
+    float bestGrowth = INFINITY;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        float g = growth(entries[i]);
+        if (g < bestGrowth)
+        {
+            best = i;
+            bestGrowth = g;
+        }
+    }
+    return best;
+}
+
+void RayLog::add(const Ray& ray, float length, const Shape* hit)
+{
+    if (hit != nullptr && std::find(hits.begin(), hits.end(), hit) == hits.end())
+        hits.push_back(hit);
+
+    if (std::isinf(length))
+    {
+        Misses added;
+        added.origins.add(ray.origin);
+        added.directions.add(ray.direction);
+        if (misses.size() < maxMisses)
+        {
+            misses.push_back(added);
+            return;
+        }
+        auto& m = misses[leastGrowth(misses, [&](const Misses& m) {
+            return m.origins.growth(added.origins) + m.directions.growth(added.directions);
+        })];
+        m.origins.add(added.origins);
+        m.directions.add(added.directions);
+        return;
+    }
+
+    float start = 0.f;
+    for (float end = 1.f; start <= length; end *= 2.f)
+    {
+        Bounds piece;
+        piece.add(ray.pos(start));
+        piece.add(ray.pos(std::min(end, length)));
+        start = end;
+        if (segments.size() < maxSegments)
+            segments.push_back(piece);
+        else
+            segments[leastGrowth(segments, [&](const Bounds& b) { return b.growth(piece); })].add(piece);
+    }
+}
+
+bool RayLog::mayHit(const Bounds& bounds) const
+{
+    for (const auto& segment : segments)
+    {
+        if (segment.overlaps(bounds))
+            return true;
+    }
+
+    // For t >= 0 misses cover [origin min + t * direction min, origin max + t * direction max] on every axis,
+    // they can only reach bounds at a t where that overlaps it on all three.
+    for (const auto& m : misses)
+    {
+        bool possible = true;
+        float tMin = 0.f;
+        float tMax = INFINITY;
+        auto axis = [&](float originMin, float originMax, float directionMin, float directionMax, float boundsMin, float boundsMax) {
+            // the lowest ray is below the top of bounds
+            if (directionMin > 0.f)
+                tMax = std::min(tMax, (boundsMax - originMin) / directionMin);
+            else if (directionMin < 0.f)
+                tMin = std::max(tMin, (boundsMax - originMin) / directionMin);
+            else if (originMin > boundsMax)
+                possible = false;
+            // and the highest one above its bottom
+            if (directionMax < 0.f)
+                tMax = std::min(tMax, (boundsMin - originMax) / directionMax);
+            else if (directionMax > 0.f)
+                tMin = std::max(tMin, (boundsMin - originMax) / directionMax);
+            else if (originMax < boundsMin)
+                possible = false;
+        };
+        axis(m.origins.min.x, m.origins.max.x, m.directions.min.x, m.directions.max.x, bounds.min.x, bounds.max.x);
+        axis(m.origins.min.y, m.origins.max.y, m.directions.min.y, m.directions.max.y, bounds.min.y, bounds.max.y);
+        axis(m.origins.min.z, m.origins.max.z, m.directions.min.z, m.directions.max.z, bounds.min.z, bounds.max.z);
+        if (possible && tMin <= tMax)
+            return true;
+    }
+    return false;
+}
+
+RayLog* RayLog::active()
+{
+    return activeLog;
+}
+
+void RayLog::setActive(RayLog* log)
+{
+    activeLog = log;
+}
+
+static void logRay(const Ray& ray, float length, const Shape* hit)
+{
+    if (auto log = RayLog::active())
+        log->add(ray, length, hit);
+}
+
+static unsigned int hashFloats(const float* values, size_t count)
+{
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned int bits;
+        std::memcpy(&bits, &values[i], sizeof(bits));
+        h = (h ^ bits) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+// Uniform number in [0, 1) derived from the ray, so the result doesn't depend on which thread traces it
+static float rouletteNumber(const Ray& ray)
+{
+    const float values[6] = { ray.origin.x, ray.origin.y, ray.origin.z, ray.direction.x, ray.direction.y, ray.direction.z };
+    return (hashFloats(values, 6) >> 8) * (1.f / 16777216.f);
+}
+
+// every light gets its own sampler dimension, so lights sampled for the same pixel don't share a pattern
+static unsigned int lightDimension(const Light& light)
+{
+    const float values[3] = { light.position.x, light.position.y, light.position.z };
+    return Sampler::Light + (hashFloats(values, 3) >> 1);
+}
 
 World::World()
-    : objects(), light()
+    : objects(), materials(std::make_unique<MaterialLibrary>()), lightThreshold(1.f / 512.f), rayThreshold(1.f / 512.f), russianRoulette(false), sampler(nullptr), lights(), areaLights()
 {
 }
 
@@ -14,11 +184,11 @@ World::World()
 World World::Default()
 {
     World w = World();
-    w.light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
+    w.lights.push_back(PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1)));
     auto s1 = new Sphere();
-    s1->material.color = Color(0.8f, 1.0f, 0.6f);
-    s1->material.diffuse = 0.7f;
-    s1->material.specular = 0.2f;
+    s1->material->color = Color(0.8f, 1.0f, 0.6f);
+    s1->material->diffuse = 0.7f;
+    s1->material->specular = 0.2f;
     auto s2 = new Sphere();
     s2->transform = scaling(0.5f, 0.5f, 0.5f);
     w.addObject(s1);
@@ -54,6 +224,7 @@ bool World::contains(const Shape& p) const
 
 void World::addObject(Shape* p)
 {
+    p->material.moveTo(*materials);
     objects.push_back(p);
 }
 
@@ -62,35 +233,281 @@ Shape* World::getObject(size_t index)
     return objects[index];
 }
 
+const Shape* World::getObject(size_t index) const
+{
+    return objects[index];
+}
+
+MaterialRef World::addMaterial(const Material& m)
+{
+    return MaterialRef(*materials, materials->add(m));
+}
+
+MaterialLibrary& World::getMaterials()
+{
+    return *materials;
+}
+
+float World::getLightThreshold() const
+{
+    return lightThreshold;
+}
+
+void World::setLightThreshold(float threshold)
+{
+    lightThreshold = threshold;
+}
+
+float World::getRayThreshold() const
+{
+    return rayThreshold;
+}
+
+void World::setRayThreshold(float threshold)
+{
+    rayThreshold = threshold;
+}
+
+bool World::getRussianRoulette() const
+{
+    return russianRoulette;
+}
+
+void World::setRussianRoulette(bool enabled)
+{
+    russianRoulette = enabled;
+}
+
+const Sampler* World::getSampler() const
+{
+    return sampler;
+}
+
+void World::setSampler(const Sampler* sampler)
+{
+    this->sampler = sampler;
+}
+
+void World::buildLightTree()
+{
+    TRACE_SCOPE("build light tree");
+    lightTree.build(lights);
+}
+
+const LightTree& World::getLightTree() const
+{
+    return lightTree;
+}
+
 Intersections World::intersect(const Ray& ray) const
 {
     auto ret = Intersections();
+    intersect(ray, ret);
+    return ret;
+}
+
+void World::intersect(const Ray& ray, Intersections& xs) const
+{
+    xs.clear();
+    for (auto o : objects)
+        intersect(*o, o->transform.getInverse(), ray, xs);
+    xs.sort();
+}
+
+void World::intersect(const std::vector<Ray>& rays, std::vector<Intersections>& xs) const
+{
+    if (xs.size() < rays.size())
+        xs.resize(rays.size());
+    for (size_t i = 0; i < rays.size(); i++)
+        xs[i].clear();
+
     for (auto o : objects)
     {
-        auto xs = o->intersect(ray);
-        ret += xs;
+        for (size_t i = 0; i < rays.size(); i++)
+            intersect(*o, o->transform.getInverse(), rays[i], xs[i]);
     }
-    return ret;
+
+    for (size_t i = 0; i < rays.size(); i++)
+        xs[i].sort();
 }
 
-Color World::colorAt(const Ray& ray, unsigned int remaining) const
+void World::intersect(const Shape& o, const Matrix<4, 4>& inverseTransform, const Ray& ray, Intersections& xs) const
 {
-    auto xs = intersect(ray);
-    auto hit = xs.hit();
-    if (hit == nullptr)
-        return Color(0, 0, 0);
-    auto comps = hit->prepare(ray);
-    return comps.shade(*this, remaining);
+    bool fromSurface = &o == ray.source && o.isConvex();
+
+    // the ray starts on o, only the far side of a closed shape it heads into can be hit
+    if (fromSurface && (!ray.intoSource || !o.isClosed()))
+        return;
+
+    auto oxs = o.intersect(ray, inverseTransform);
+    if (auto stats = RenderStats::active())
+        stats->countShapeTest(o.typeName(), oxs.count() > 0);
+
+    if (!fromSurface)
+    {
+        xs.append(oxs);
+    }
+    else if (oxs.count() > 0)
+    {
+        // the entry is kept behind the origin even where rounding puts it in front, Intersection::prepare needs it
+        // to know that the ray is inside o
+        auto range = std::minmax_element(oxs.begin(), oxs.end(), [](const Intersection& a, const Intersection& b) { return a.t < b.t; });
+        xs.append(Intersections{ Intersection(std::min(range.first->t, 0.f), &o), *range.second });
+    }
+}
+
+bool World::survives(PendingRay& pending) const
+{
+    if (pending.weight >= rayThreshold)
+        return true;
+    if (!russianRoulette || rouletteNumber(pending.ray) * rayThreshold >= pending.weight)
+        return false;
+    pending.weight = rayThreshold;
+    return true;
 }
 
-bool World::isShadowed(const Tuple& point) const
+Color World::colorAt(const Ray& ray, unsigned int remaining, const Shape** hit, float* distance) const
 {
-    auto direction = light.position - point;
+    auto& rays = scratch().rays;
+    size_t base = rays.size();
+    rays.push_back({ ray, 1.f, remaining });
+    return trace(base, hit, distance);
+}
+
+Color World::traceSecondary(const Computations& comps, unsigned int remaining) const
+{
+    auto& rays = scratch().rays;
+    size_t base = rays.size();
+    comps.spawn(1.f, remaining, rays);
+    return trace(base);
+}
+
+Color World::trace(size_t base, const Shape** firstHit, float* firstDistance) const
+{
+    auto& s = scratch();
+    auto color = Color(0);
+    if (firstHit != nullptr)
+        *firstHit = nullptr;
+    if (firstDistance != nullptr)
+        *firstDistance = 0.f;
+
+    // rays below base belong to a caller further up
+    while (s.rays.size() > base)
+    {
+        auto pending = s.rays.back();
+        s.rays.pop_back();
+
+        // rays that can't visibly change the pixel are dropped
+        if (!survives(pending))
+            continue;
+
+        const Intersection* hit;
+        {
+            StageTimer timer(RenderStats::Intersect);
+            intersect(pending.ray, s.xs);
+            hit = s.xs.hit();
+        }
+        logRay(pending.ray, hit != nullptr ? hit->t : INFINITY, hit != nullptr ? hit->primitive : nullptr);
+        // the first ray popped is the one trace was called for
+        if (firstHit != nullptr)
+        {
+            *firstHit = hit != nullptr ? hit->primitive : nullptr;
+            firstHit = nullptr;
+        }
+        if (firstDistance != nullptr)
+        {
+            *firstDistance = hit != nullptr ? hit->t : 0.f;
+            firstDistance = nullptr;
+        }
+        if (hit == nullptr)
+            continue;
+
+        StageTimer timer(RenderStats::Shading);
+        auto comps = hit->prepare(pending.ray, s.xs);
+        color = color + comps.surfaceColor(*this) * pending.weight;
+        comps.spawn(pending.weight, pending.remaining, s.rays);
+    }
+
+    return color;
+}
+
+bool World::isShadowed(const Tuple& point, const Light& light) const
+{
+    return isOccluded(point, light.position, nullptr);
+}
+
+float World::visibility(const Tuple& point, const Light& light) const
+{
+    return visibility(point, light, nullptr);
+}
+
+float World::visibility(const Computations& comps, const Light& light) const
+{
+    return visibility(comps.point, light, &comps);
+}
+
+float World::visibility(const Tuple& point, const Light& light, const Computations* from) const
+{
+    unsigned int n = light.getSamples();
+    if (n <= 1)
+        return isOccluded(point, light.position, from) ? 0.f : 1.f;
+
+    // one probe in the middle of every quadrant, if they agree the point is fully lit or in the umbra. Without more
+    // than 4 samples the probes would cost as much as the grid, which is then taken right away.
+    unsigned int visible = 0;
+    unsigned int probes = 0;
+    if (n * n > 4)
+    {
+        for (; probes < 4; probes++)
+        {
+            if (!isOccluded(point, light.pointOn(probes % 2 == 0 ? 0.25f : 0.75f, probes < 2 ? 0.25f : 0.75f, point), from))
+                visible++;
+        }
+        if (visible == 0 || visible == 4)
+            return visible / 4.f;
+    }
+
+    // penumbra, take the full grid of samples
+    if (sampler == nullptr)
+    {
+        for (unsigned int v = 0; v < n; v++)
+            for (unsigned int u = 0; u < n; u++)
+            {
+                if (!isOccluded(point, light.pointOn((u + 0.5f) / n, (v + 0.5f) / n, point), from))
+                    visible++;
+            }
+    }
+    else
+    {
+        unsigned int dimension = lightDimension(light);
+        for (unsigned int i = 0; i < n * n; i++)
+        {
+            auto sample = sampler->get(Sampler::current(), dimension, i, n * n);
+            if (!isOccluded(point, light.pointOn(sample.u, sample.v, point), from))
+                visible++;
+        }
+    }
+
+    return visible / (float)(probes + n * n);
+}
+
+bool World::isOccluded(const Tuple& point, const Tuple& target, const Computations* from) const
+{
+    auto direction = target - point;
     auto distance = length(direction);
-    auto ray = Ray(point, normalize(direction));
+    direction = direction / distance;
+    auto ray = from != nullptr ? from->spawnRay(direction) : Ray(point, direction);
+
+    StageTimer timer(RenderStats::Shadows);
+    if (auto stats = RenderStats::active())
+        stats->shadowRays++;
 
-    auto xs = intersect(ray);
+    auto& xs = scratch().shadowXs;
+    intersect(ray, xs);
     auto hit = xs.hit();
+    bool occluded = hit != nullptr && hit->t < distance;
+    // nothing else can change the result of a blocked shadow ray
+    logRay(ray, occluded ? 0.f : distance, occluded ? hit->primitive : nullptr);
 
-    return hit != nullptr && hit->t < distance;
+    return occluded;
 }
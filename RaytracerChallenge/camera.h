@@ -1,10 +1,74 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
 #include "math.h"
 #include "ray.h"
 #include "canvas.h"
+#include "stats.h"
 
 class World;
+class Shape;
+class Sampler;
+
+// What renderWithStats records per pixel into RenderResult::cost.
+enum class PixelCost
+{
+	None,
+	Time,	// seconds
+	Rays	// primary and secondary rays including shadow rays
+};
+
+struct RenderResult
+{
+	Canvas canvas;
+	RenderStats stats;
+	Canvas cost;	// empty unless a PixelCost is set, see Canvas::heatmap()
+};
+
+// Stops a render early, once cancel was called from any thread or the deadline passed. Workers check it before
+// every pixel.
+class RenderBudget
+{
+private:
+	std::atomic<bool> cancelled;
+	bool hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+
+public:
+	// no deadline, runs until cancelled
+	RenderBudget();
+	explicit RenderBudget(std::chrono::steady_clock::time_point deadline);
+	explicit RenderBudget(std::chrono::steady_clock::duration budget);
+
+	RenderBudget(const RenderBudget&) = delete;
+	RenderBudget& operator=(const RenderBudget&) = delete;
+
+	void cancel();
+	bool expired() const;
+};
+
+struct PartialRender
+{
+	Canvas canvas;
+	float completed;	// fraction of the pixels traced, 1 if the render finished
+};
+
+// A rectangle of pixels of the frame, (x, y) is its top left corner.
+struct Region
+{
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+};
+
+// Called by renderProgressive with the image after every pass. Pixels that weren't traced yet hold the color of
+// the closest traced pixel above and to the left of them.
+using ProgressCallback = std::function<void(const Canvas& image, unsigned int pass, unsigned int passes)>;
 
 class Camera
 {
@@ -12,11 +76,16 @@ private:
 	unsigned int width;
 	unsigned int height;
 	float fov;
-	Matrix<4, 4> transform;
+	Transform transform;
 	float pixelSize;
 	float halfWidth;
 	float halfHeight;
 	unsigned int maxBounces;
+	PixelCost pixelCost;
+	unsigned int threads;
+	unsigned int antialiasSamples;
+	float antialiasThreshold;
+	const Sampler* sampler;
 
 public:
 	Camera(unsigned int width, unsigned int height, float fov);
@@ -28,7 +97,81 @@ public:
 	void setTransform(const Matrix<4, 4>& transform);
 	float getPixelSize() const;
 	Ray getRay(unsigned int x, unsigned int y) const;
+	// ray through the point (u, v) in [0, 1)^2 of the pixel, (0.5, 0.5) is its center
+	Ray getRay(unsigned int x, unsigned int y, float u, float v) const;
+	// Appends the rays through the centers of count pixels, starting from the first-th pixel in row major order.
+	// Same as getRay, with the transform inverted once for all of them.
+	void getRays(unsigned int first, unsigned int count, std::vector<Ray>& rays) const;
+	// Where point is in the frame, in pixels: the center of pixel (x, y) is at (x + 0.5, y + 0.5). A vector is taken
+	// as the direction to a point at infinity. depth is the distance along the view axis, infinite for a vector.
+	// Returns false for points behind the camera.
+	bool project(const Tuple& point, float& x, float& y, float& depth) const;
 	Canvas render(const World& world) const;
+	// Renders only the pixels of region, clipped to the frame, into a canvas of its size. They come out exactly as
+	// in render, antialiasing included.
+	Canvas renderRegion(const World& world, const Region& region) const;
+	// Same, into target with the top left corner of the region at (targetX, targetY).
+	void renderRegion(const World& world, const Region& region, Canvas& target, unsigned int targetX, unsigned int targetY) const;
+	// Renders while counting rays, shape tests and the time spent per stage.
+	RenderResult renderWithStats(const World& world) const;
+	// Traces every blockSize-th pixel of every blockSize-th row first and fills the blocks with it, then halves the
+	// block size every pass until all pixels are traced. Every pixel is traced once, the last pass then antialiases
+	// the frame like render does and gives the same image. blockSize is rounded up to a power of two.
+	Canvas renderProgressive(const World& world, const ProgressCallback& callback, unsigned int blockSize = 8) const;
+	// Renders progressively until done or the budget expires. The coarse passes come first, so an early stop still
+	// covers the whole frame, only at a lower resolution. The callback is called for completed passes only.
+	PartialRender renderWithin(const World& world, const RenderBudget& budget, const ProgressCallback& callback = nullptr, unsigned int blockSize = 8) const;
+	unsigned int getMaxBounces() const;
 	void setMaxBounces(unsigned int maxBounces);
+	void setPixelCost(PixelCost pixelCost);
+	unsigned int getThreads() const;
+	// Rows are handed out to this many threads, 0 uses one per hardware thread. The image is bit-identical for any
+	// number of threads: every random choice derives from the pixel and sample index or from the ray, and every pixel
+	// is accumulated by one thread in a fixed order.
+	void setThreads(unsigned int threads);
+	unsigned int getAntialiasSamples() const;
+	// After tracing the pixel centers, pixels whose color differs from a neighbor's by more than threshold in any
+	// channel, or whose neighbor hit another object, are resampled with up to maxSamples rays on a regular grid.
+	// Below 4 samples there is no antialiasing. Every render antialiases, the progressive ones after their last pass.
+	void setAntialiasing(unsigned int maxSamples, float threshold = 0.1f);
+	// Positions of the antialiasing samples in the pixel, the regular grid if null. Not owned.
+	void setSampler(const Sampler* sampler);
+
+	// Runs work on getThreads() threads, each counting into its own stats, which are merged into the caller's active
+	// stats once all are done.
+	void runWorkers(const std::function<void()>& work) const;
+
+private:
+	// Pixels traced by a pass: those at multiples of step, minus those at multiples of 2 * step if it refines
+	// a previous pass. Each traced pixel fills the step x step block it is the corner of.
+	struct Pass
+	{
+		unsigned int step;
+		bool refine;
+	};
+
+	// state shared by the workers of a pass
+	struct RenderJob
+	{
+		Canvas& image;
+		Canvas* cost;	// indexed like the frame
+		Pass pass;
+		const RenderBudget* budget;
+		Region region;	// of the frame
+		int offsetX;	// pixel (x, y) of the frame goes to (x + offsetX, y + offsetY) of image
+		int offsetY;
+		const Shape** hits = nullptr;	// per pixel of image, the object hit by its primary ray
+		std::atomic<unsigned int> nextRow = 0;
+		std::atomic<unsigned long long> tracedPixels = 0;
+	};
+
+	Region frame() const;
+	Region clip(const Region& region) const;
+	void renderFrame(const World& world, const Region& region, Canvas& image, int offsetX, int offsetY, Canvas* cost) const;
+	// returns the number of pixels traced
+	unsigned long long render(const World& world, RenderJob& job) const;
+	void renderRows(const World& world, RenderJob& job) const;
+	// centers and hits cover border, the region of job plus the pixels around it
+	void antialiasRows(const World& world, RenderJob& job, const Canvas& centers, const std::vector<const Shape*>& hits, const Region& border) const;
 };
 
@@ -1,9 +1,12 @@
 #include <sstream>
 #include <algorithm>
 #include <fstream>
+#include <cmath>
+#include <cstring>
 
 #include "canvas.h"
 #include "color.h"
+#include "trace.h"
 
 Canvas::Canvas(const size_t width, const size_t height)
 	: width(width), height(height), buffer(width * height)
@@ -24,6 +27,49 @@ const Color& Canvas::at(size_t x, size_t y) const
 	return buffer.at(y * width + x);
 }
 
+unsigned long long Canvas::fingerprint() const
+{
+	// FNV-1a
+	unsigned long long h = 14695981039346656037ull;
+	for (const auto& color : buffer)
+	{
+		const float channels[3] = { color.r, color.g, color.b };
+		for (float c : channels)
+		{
+			unsigned int bits;
+			std::memcpy(&bits, &c, sizeof(bits));
+			h = (h ^ bits) * 1099511628211ull;
+		}
+	}
+	return h;
+}
+
+Canvas Canvas::heatmap() const
+{
+	static const Color ramp[] = { Color(0, 0, 1), Color(0, 1, 1), Color(0, 1, 0), Color(1, 1, 0), Color(1, 0, 0) };
+	const int last = 4;
+
+	float low = INFINITY;
+	float high = 0.f;
+	for (const auto& c : buffer)
+	{
+		low = std::min(low, c.r);
+		high = std::max(high, c.r);
+	}
+
+	Canvas map(width, height);
+	float range = logf(1.f + high - low);
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		float t = range > 0.f ? logf(1.f + buffer[i].r - low) / range * last : 0.f;
+		int index = std::min((int)t, last - 1);
+		float f = t - index;
+		map.buffer[i] = ramp[index] * (1.f - f) + ramp[index + 1] * f;
+	}
+
+	return map;
+}
+
 std::string Canvas::getPPM() const
 {
 	std::stringstream ss;
@@ -35,13 +81,43 @@ std::string Canvas::getPPM() const
 void Canvas::savePPM(const std::string& path) const
 {
 	std::ofstream file;
-	file.open("canvas.ppm");
+	file.open(path);
 	writePPM(file);
 	file.close();
 }
 
+Canvas Canvas::fromPPM(std::istream& stream)
+{
+	std::string magic;
+	size_t w = 0;
+	size_t h = 0;
+	float maxValue = 0.f;
+	stream >> magic >> w >> h >> maxValue;
+	if (!stream || magic != "P3" || maxValue <= 0.f)
+		return Canvas(0, 0);
+
+	Canvas c(w, h);
+	for (auto& color : c.buffer)
+	{
+		float r, g, b;
+		stream >> r >> g >> b;
+		if (!stream)
+			return Canvas(0, 0);
+		color = Color(r / maxValue, g / maxValue, b / maxValue);
+	}
+
+	return c;
+}
+
+Canvas Canvas::loadPPM(const std::string& path)
+{
+	std::ifstream file(path);
+	return fromPPM(file);
+}
+
 void Canvas::writePPM(std::ostream& stream) const
 {
+	TRACE_SCOPE("encode canvas");
 	stream << "P3" << std::endl;
 	stream << width << " " << height << std::endl;
 	stream << 255 << std::endl;
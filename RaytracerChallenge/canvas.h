@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <iosfwd>
 
 class Color;
 
@@ -20,9 +21,18 @@ public:
 	void writePixel(size_t x, size_t y, const Color& c);
 	const Color& at(size_t x, size_t y) const;
 
+	// False-color image of the red channel, blue for the lowest values up to red for the highest. The scale is
+	// logarithmic so a few pathological pixels don't flatten the rest.
+	Canvas heatmap() const;
+
+	// Hash of the bits of every channel, equal only for bit-identical images.
+	unsigned long long fingerprint() const;
 
 	std::string getPPM() const;
 	void savePPM(const std::string& path) const;
+	// Reads a plain (P3) PPM, returns an empty canvas if it can't be parsed.
+	static Canvas fromPPM(std::istream& stream);
+	static Canvas loadPPM(const std::string& path);
 
 private:
 	void writePPM(std::ostream& stream) const;
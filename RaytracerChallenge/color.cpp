@@ -2,6 +2,7 @@
 #include "math.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 Color::Color(float r, float g, float b)
 	: r(r), g(g), b(b)
@@ -68,3 +69,8 @@ bool areEqual(const Color& lhs, const Color& rhs)
 	return areEqual(lhs.r, rhs.r) && areEqual(lhs.g, rhs.g) && areEqual(lhs.b, rhs.b);
 }
 
+float maxComponent(const Color& c)
+{
+	return std::max(c.r, std::max(c.g, c.b));
+}
+
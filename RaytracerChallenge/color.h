@@ -27,6 +27,8 @@ public:
 	friend std::wstring ToString(const Color& c);
 
 	friend bool areEqual(const Color& a, const Color& b);
+
+	friend float maxComponent(const Color& c);
 };
 
 
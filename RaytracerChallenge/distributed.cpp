@@ -0,0 +1,413 @@
+#include "distributed.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "camera.h"
+#include "color.h"
+#include "scenes.h"
+#include "trace.h"
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using Socket = SOCKET;
+static const Socket invalidSocket = INVALID_SOCKET;
+
+static void closeSocket(Socket s)
+{
+	closesocket(s);
+}
+
+// whether the last socket call failed only because a signal interrupted it
+static bool interrupted()
+{
+	return WSAGetLastError() == WSAEINTR;
+}
+
+static bool startSockets()
+{
+	static const bool started = [] {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return started;
+}
+#else
+using Socket = int;
+static const Socket invalidSocket = -1;
+
+static void closeSocket(Socket s)
+{
+	close(s);
+}
+
+static bool interrupted()
+{
+	return errno == EINTR;
+}
+
+static bool startSockets()
+{
+	return true;
+}
+#endif
+
+#ifdef MSG_NOSIGNAL
+static const int sendFlags = MSG_NOSIGNAL;	// a closed peer is an error, not a SIGPIPE
+#else
+static const int sendFlags = 0;
+#endif
+
+static bool sendAll(Socket s, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		int sent = send(s, data, (int)std::min(size, (size_t)1 << 20), sendFlags);
+		if (sent < 0 && interrupted())
+			continue;
+		if (sent <= 0)
+			return false;
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+static bool sendLine(Socket s, const std::string& line)
+{
+	return sendAll(s, (line + "\n").c_str(), line.size() + 1);
+}
+
+// appends what is available to buffer, false once the peer is gone
+static bool receive(Socket s, std::string& buffer)
+{
+	char chunk[1 << 16];
+	int received;
+	do
+		received = recv(s, chunk, sizeof(chunk), 0);
+	while (received < 0 && interrupted());
+	if (received <= 0)
+		return false;
+	buffer.append(chunk, received);
+	return true;
+}
+
+// takes the first line off buffer
+static bool takeLine(std::string& buffer, std::string& line)
+{
+	auto end = buffer.find('\n');
+	if (end == std::string::npos)
+		return false;
+	line = buffer.substr(0, end);
+	buffer.erase(0, end + 1);
+	return true;
+}
+
+static void setNoDelay(Socket s)
+{
+	int on = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+unsigned int TileJob::getTileCount() const
+{
+	return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+void TileJob::getTile(unsigned int index, unsigned int& x, unsigned int& y, unsigned int& w, unsigned int& h) const
+{
+	unsigned int columns = (width + tileSize - 1) / tileSize;
+	x = (index % columns) * tileSize;
+	y = (index / columns) * tileSize;
+	w = std::min(tileSize, width - x);
+	h = std::min(tileSize, height - y);
+}
+
+Canvas coordinateRender(const TileJob& job, const CoordinatorOptions& options)
+{
+	if (!startSockets() || job.tileSize == 0)
+		return Canvas(0, 0);
+
+	Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+	int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(options.port);
+	socklen_t length = sizeof(address);
+	if (listener == invalidSocket || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0
+		|| getsockname(listener, (sockaddr*)&address, &length) != 0)
+	{
+		std::cerr << "can't listen on port " << options.port << std::endl;
+		if (listener != invalidSocket)
+			closeSocket(listener);
+		return Canvas(0, 0);
+	}
+	if (options.onListening)
+		options.onListening(ntohs(address.sin_port));
+
+	struct Worker
+	{
+		Socket socket;
+		std::string received;
+		int tile;	// -1 while idle
+		Clock::time_point since;
+	};
+
+	const unsigned int count = job.getTileCount();
+	std::vector<bool> done(count, false);
+	std::deque<unsigned int> pending;
+	for (unsigned int i = 0; i < count; i++)
+		pending.push_back(i);
+	unsigned int remaining = count;
+
+	std::vector<Worker> workers;
+	auto image = Canvas(job.width, job.height);
+
+	std::stringstream jobLine;
+	jobLine << "JOB " << job.scene << " " << job.width << " " << job.height << " " << job.tileSize << " " << job.antialiasSamples;
+
+	auto assign = [&](Worker& worker) {
+		// a reassigned tile may have been finished by its first worker after all
+		while (!pending.empty() && done[pending.front()])
+			pending.pop_front();
+		worker.tile = -1;
+		if (pending.empty())
+			return true;
+
+		worker.tile = pending.front();
+		worker.since = Clock::now();
+		pending.pop_front();
+		return sendLine(worker.socket, "TILE " + std::to_string(worker.tile));
+	};
+	auto drop = [&](size_t i) {
+		auto& worker = workers[i];
+		if (worker.tile >= 0 && !done[worker.tile])
+			pending.push_front(worker.tile);
+		closeSocket(worker.socket);
+		workers.erase(workers.begin() + i);
+	};
+	// handles every complete message received, false on a protocol error
+	auto process = [&](Worker& worker) {
+		while (true)
+		{
+			auto end = worker.received.find('\n');
+			if (end == std::string::npos)
+				return true;
+
+			std::stringstream ss(worker.received.substr(0, end));
+			std::string command;
+			int index = -1;
+			ss >> command >> index;
+			if (command != "DONE" || index < 0 || (unsigned int)index >= count)
+				return false;
+
+			unsigned int x, y, w, h;
+			job.getTile(index, x, y, w, h);
+			size_t bytes = (size_t)w * h * 3 * sizeof(float);
+			if (worker.received.size() < end + 1 + bytes)
+				return true;
+
+			if (!done[index])
+			{
+				std::vector<float> pixels(w * h * 3);
+				std::memcpy(pixels.data(), worker.received.data() + end + 1, bytes);
+				for (unsigned int ty = 0; ty < h; ty++)
+					for (unsigned int tx = 0; tx < w; tx++)
+					{
+						const float* p = &pixels[(ty * w + tx) * 3];
+						image.writePixel(x + tx, y + ty, Color(p[0], p[1], p[2]));
+					}
+				done[index] = true;
+				remaining--;
+			}
+			worker.received.erase(0, end + 1 + bytes);
+			if (worker.tile == index && !assign(worker))
+				return false;
+		}
+	};
+
+	bool failed = false;
+	while (remaining > 0)
+	{
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(listener, &readable);
+		Socket highest = listener;
+		for (const auto& worker : workers)
+		{
+			FD_SET(worker.socket, &readable);
+			highest = std::max(highest, worker.socket);
+		}
+		timeval wait = { 0, 100000 };
+		if (select((int)highest + 1, &readable, nullptr, nullptr, &wait) < 0)
+		{
+			// a signal only cuts the wait short
+			if (interrupted())
+				continue;
+			std::cerr << "waiting for the workers failed" << std::endl;
+			failed = true;
+			break;
+		}
+
+		for (size_t i = workers.size(); i-- > 0;)
+		{
+			auto& worker = workers[i];
+			if (FD_ISSET(worker.socket, &readable) && (!receive(worker.socket, worker.received) || !process(worker)))
+				drop(i);
+			else if (worker.tile >= 0 && Clock::now() - worker.since > options.tileTimeout)
+				drop(i);
+		}
+
+		if (FD_ISSET(listener, &readable))
+		{
+			Socket s = accept(listener, nullptr, nullptr);
+			if (s != invalidSocket)
+			{
+				setNoDelay(s);
+				workers.push_back({ s, "", -1, Clock::now() });
+				if (!sendLine(s, jobLine.str()))
+					drop(workers.size() - 1);
+			}
+		}
+
+		// idle workers pick up new and reassigned tiles
+		for (size_t i = workers.size(); i-- > 0;)
+		{
+			if (workers[i].tile < 0 && !assign(workers[i]))
+				drop(i);
+		}
+	}
+
+	for (const auto& worker : workers)
+	{
+		sendLine(worker.socket, "EXIT");
+		closeSocket(worker.socket);
+	}
+	closeSocket(listener);
+	if (failed)
+		return Canvas(0, 0);
+	return image;
+}
+
+int runRenderWorker(const WorkerOptions& options)
+{
+	if (!startSockets())
+		return -1;
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(options.port);
+	if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1)
+	{
+		std::cerr << "invalid host " << options.host << std::endl;
+		return -1;
+	}
+
+	Socket s = invalidSocket;
+	auto giveUp = Clock::now() + options.connectTimeout;
+	while (true)
+	{
+		s = socket(AF_INET, SOCK_STREAM, 0);
+		if (s != invalidSocket && connect(s, (sockaddr*)&address, sizeof(address)) == 0)
+			break;
+		if (s != invalidSocket)
+			closeSocket(s);
+		s = invalidSocket;
+		if (Clock::now() >= giveUp)
+		{
+			std::cerr << "can't connect to " << options.host << ":" << options.port << std::endl;
+			return -1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	setNoDelay(s);
+
+	std::string received;
+	std::string line;
+	auto nextLine = [&]() {
+		while (!takeLine(received, line))
+		{
+			if (!receive(s, received))
+				return false;
+		}
+		return true;
+	};
+
+	TileJob job;
+	std::string command;
+	if (!nextLine() || !(std::stringstream(line) >> command >> job.scene >> job.width >> job.height >> job.tileSize >> job.antialiasSamples) || command != "JOB")
+	{
+		closeSocket(s);
+		return -1;
+	}
+
+	auto scene = Scene::byName(job.scene);
+	if (scene == nullptr)
+	{
+		std::cerr << "unknown scene " << job.scene << std::endl;
+		closeSocket(s);
+		return -1;
+	}
+	auto camera = scene->camera(job.width, job.height);
+	camera.setThreads(options.threads);
+	camera.setAntialiasing(job.antialiasSamples);
+
+	int rendered = 0;
+	while (nextLine())
+	{
+		unsigned int index = 0;
+		std::stringstream ss(line);
+		if (!(ss >> command) || command != "TILE" || !(ss >> index) || index >= job.getTileCount())
+			break;
+		if (options.maxTiles > 0 && rendered == (int)options.maxTiles)
+			break;
+
+		TRACE_SCOPE("render tile");
+		unsigned int x, y, w, h;
+		job.getTile(index, x, y, w, h);
+		auto tile = camera.renderRegion(scene->world, { x, y, w, h });
+
+		std::vector<float> pixels;
+		pixels.reserve(w * h * 3);
+		for (unsigned int ty = 0; ty < h; ty++)
+			for (unsigned int tx = 0; tx < w; tx++)
+			{
+				const auto& c = tile.at(tx, ty);
+				pixels.push_back(c.r);
+				pixels.push_back(c.g);
+				pixels.push_back(c.b);
+			}
+
+		if (!sendLine(s, "DONE " + std::to_string(index)) || !sendAll(s, (const char*)pixels.data(), pixels.size() * sizeof(float)))
+			break;
+		rendered++;
+	}
+
+	closeSocket(s);
+	return rendered;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "canvas.h"
+
+// Rendering a frame with several processes. A coordinator listens on a TCP port of the local host and hands out
+// tiles one at a time to every worker that connects. Workers load the scene by name, render their tile with
+// Camera::renderRegion and send the pixels back. A worker that disconnects or holds a tile longer than the tile
+// timeout is dropped and its tile handed to the next idle worker, so workers can come and go during a render.
+//
+// The protocol is lines of text, followed by the raw floats of the pixels after DONE:
+//   coordinator: JOB <scene> <width> <height> <tile size> <antialias samples>
+//   coordinator: TILE <index>                   tiles are numbered row by row
+//   worker:      DONE <index> <floats>          r, g, b of every pixel of the tile, row by row
+//   coordinator: EXIT
+
+// What the workers render, sent to every worker when it connects.
+struct TileJob
+{
+	std::string scene;	// see Scene::byName
+	unsigned int width;
+	unsigned int height;
+	unsigned int tileSize;
+	unsigned int antialiasSamples;
+
+	unsigned int getTileCount() const;
+	// the pixels of a tile, clipped to the frame
+	void getTile(unsigned int index, unsigned int& x, unsigned int& y, unsigned int& w, unsigned int& h) const;
+};
+
+struct CoordinatorOptions
+{
+	unsigned short port = 0;	// 0 picks a free port, see onListening
+	std::chrono::milliseconds tileTimeout = std::chrono::minutes(5);
+	// called with the port once the coordinator accepts workers
+	std::function<void(unsigned short port)> onListening;
+};
+
+struct WorkerOptions
+{
+	std::string host = "127.0.0.1";
+	unsigned short port = 0;
+	unsigned int threads = 0;	// see Camera::setThreads
+	// Leave when handed the tile after this many, 0 to stay until the frame is done. The tile is left to others.
+	unsigned int maxTiles = 0;
+	// keep trying to connect this long, so workers can be started before the coordinator
+	std::chrono::milliseconds connectTimeout = std::chrono::seconds(10);
+};
+
+// Blocks until every tile is rendered, returns the frame. The canvas is empty if the port can't be listened on or
+// waiting for the workers fails, a frame with tiles missing is never returned.
+Canvas coordinateRender(const TileJob& job, const CoordinatorOptions& options);
+
+// Renders tiles until the coordinator is done. Returns the number of tiles rendered, -1 if it couldn't connect or
+// the scene is unknown.
+int runRenderWorker(const WorkerOptions& options);
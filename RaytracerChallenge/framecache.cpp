@@ -0,0 +1,215 @@
+#include "framecache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "ray.h"
+#include "sampler.h"
+#include "trace.h"
+#include "world.h"
+
+FrameCache::FrameCache()
+	: pixels(), width(0), height(0), transform(Matrix<4, 4>::identity()), fov(0.f), tracedPixels(0), reprojectedPixels(0),
+	refiner(), refineBudget()
+{
+}
+
+FrameCache::~FrameCache()
+{
+	stopRefine();
+}
+
+Canvas FrameCache::render(const World& world, const Camera& camera)
+{
+	stopRefine();
+	TRACE_SCOPE("render cached");
+	const unsigned int count = camera.getWidth() * camera.getHeight();
+	std::vector<unsigned int> todo;
+	tracedPixels = 0;
+	reprojectedPixels = 0;
+
+	if (pixels.empty() || width != camera.getWidth() || height != camera.getHeight())
+	{
+		width = camera.getWidth();
+		height = camera.getHeight();
+		pixels.assign(count, { Color(0), Tuple::vector(0, 0, 0), false });
+		for (unsigned int i = 0; i < count; i++)
+			todo.push_back(i);
+	}
+	else if (camera.getTransform() == transform && camera.getFov() == fov)
+	{
+		return image();
+	}
+	else
+	{
+		// the nearest of the points landing on every pixel of the new view
+		const unsigned int none = ~0u;
+		std::vector<unsigned int> source(count, none);
+		std::vector<float> depths(count, INFINITY);
+		{
+			TRACE_SCOPE("reproject");
+			for (unsigned int i = 0; i < count; i++)
+			{
+				float x, y, depth;
+				if (!camera.project(pixels[i].position, x, y, depth) || x < 0.f || y < 0.f || x >= width || y >= height)
+					continue;
+
+				unsigned int target = (unsigned int)y * width + (unsigned int)x;
+				if (source[target] == none || depth < depths[target])
+				{
+					source[target] = i;
+					depths[target] = depth;
+				}
+			}
+		}
+
+		std::vector<Pixel> next(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (source[i] == none)
+			{
+				todo.push_back(i);
+				continue;
+			}
+			next[i] = { pixels[source[i]].color, pixels[source[i]].position, false };
+			reprojectedPixels++;
+		}
+		pixels.swap(next);
+	}
+
+	transform = camera.getTransform();
+	fov = camera.getFov();
+	trace(world, camera, todo);
+	tracedPixels = (unsigned int)todo.size();
+	return image();
+}
+
+PartialRender FrameCache::refine(const World& world, const Camera& camera, const RenderBudget& budget)
+{
+	TRACE_SCOPE("refine cached");
+	std::vector<Region> tiles;
+	for (unsigned int y = 0; y < height; y += refineTile)
+	{
+		for (unsigned int x = 0; x < width; x += refineTile)
+		{
+			Region tile = { x, y, std::min(refineTile, width - x), std::min(refineTile, height - y) };
+			bool pending = false;
+			for (unsigned int ty = tile.y; ty < tile.y + tile.height && !pending; ty++)
+				for (unsigned int tx = tile.x; tx < tile.x + tile.width && !pending; tx++)
+					pending = !pixels[ty * width + tx].exact;
+			if (pending)
+				tiles.push_back(tile);
+		}
+	}
+
+	// tiles are handed out to the workers, each renders its tile on its own thread
+	auto tileCamera = camera;
+	tileCamera.setThreads(1);
+	std::atomic<size_t> next = 0;
+	camera.runWorkers([&]() {
+		auto canvas = Canvas(refineTile, refineTile);
+		for (size_t k = next++; k < tiles.size(); k = next++)
+		{
+			if (budget.expired())
+				return;
+
+			const auto& tile = tiles[k];
+			tileCamera.renderRegion(world, tile, canvas, 0, 0);
+			for (unsigned int y = tile.y; y < tile.y + tile.height; y++)
+			{
+				for (unsigned int x = tile.x; x < tile.x + tile.width; x++)
+				{
+					auto ray = camera.getRay(x, y);
+					auto xs = world.intersect(ray);
+					auto hit = xs.hit();
+					pixels[y * width + x] = { canvas.at(x - tile.x, y - tile.y), hit != nullptr ? ray.pos(hit->t) : ray.direction, true };
+				}
+			}
+		}
+	});
+
+	auto pending = getPendingPixels();
+	return { image(), pixels.empty() ? 0.f : 1.f - (float)pending / pixels.size() };
+}
+
+void FrameCache::startRefine(const World& world, const Camera& camera, const std::function<void(const PartialRender&)>& done)
+{
+	stopRefine();
+	refineBudget = std::make_unique<RenderBudget>();
+	refiner = std::thread([this, &world, camera, done]() {
+		auto result = refine(world, camera, *refineBudget);
+		if (done)
+			done(result);
+	});
+}
+
+void FrameCache::stopRefine()
+{
+	if (refineBudget != nullptr)
+		refineBudget->cancel();
+	waitForRefine();
+}
+
+void FrameCache::waitForRefine()
+{
+	if (refiner.joinable())
+		refiner.join();
+}
+
+void FrameCache::invalidate()
+{
+	stopRefine();
+	pixels.clear();
+}
+
+unsigned int FrameCache::getTracedPixels() const
+{
+	return tracedPixels;
+}
+
+unsigned int FrameCache::getReprojectedPixels() const
+{
+	return reprojectedPixels;
+}
+
+unsigned int FrameCache::getPendingPixels() const
+{
+	unsigned int pending = 0;
+	for (const auto& p : pixels)
+	{
+		if (!p.exact)
+			pending++;
+	}
+	return pending;
+}
+
+void FrameCache::trace(const World& world, const Camera& camera, const std::vector<unsigned int>& todo)
+{
+	// with antialiasing the center alone isn't the color of Camera::render, refine takes care of it
+	bool exact = camera.getAntialiasSamples() < 4;
+	std::atomic<size_t> next = 0;
+	camera.runWorkers([&]() {
+		for (size_t k = next++; k < todo.size(); k = next++)
+		{
+			unsigned int i = todo[k];
+			unsigned int x = i % width;
+			unsigned int y = i / width;
+			auto ray = camera.getRay(x, y);
+			Sampler::setCurrent({ x, y, 0 });
+
+			const Shape* hit;
+			float t;
+			auto color = world.colorAt(ray, camera.getMaxBounces(), &hit, &t);
+			pixels[i] = { color, hit != nullptr ? ray.pos(t) : ray.direction, exact };
+		}
+	});
+}
+
+Canvas FrameCache::image() const
+{
+	auto canvas = Canvas(width, height);
+	for (unsigned int i = 0; i < pixels.size(); i++)
+		canvas.writePixel(i % width, i / width, pixels[i].color);
+	return canvas;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "canvas.h"
+#include "color.h"
+#include "matrix.h"
+#include "tuple.h"
+
+class World;
+
+// Re-renders a frame after small camera moves without tracing every pixel again. The last frame is kept with where
+// the primary ray of every pixel hit the scene, or its direction for a miss. The next frame reprojects those points
+// into the new view, nearest one first, and only traces the pixels nothing lands on: what the move disoccluded,
+// what came into view at the edges and holes where the view got magnified.
+//
+// Reprojected pixels keep their old color, which is off for view dependent light (specular, reflection, refraction)
+// and where an object that wasn't in the last frame now covers them. The traced ones go through their center only,
+// with antialiasing on they aren't final either. refine renders the tiles holding such pixels again with
+// Camera::renderRegion, which gives the image of Camera::render once it's done. startRefine runs it on a thread of
+// its own between camera moves.
+//
+// The cache doesn't see edits of the world, call invalidate after one. Not thread safe: while a background refine
+// runs, only stopRefine and waitForRefine may be called, render and invalidate stop it first.
+class FrameCache
+{
+private:
+	struct Pixel
+	{
+		Color color;
+		Tuple position;	// of the hit, w is 0 for the direction of a miss
+		bool exact;	// the color of Camera::render with the current camera, not reprojected
+	};
+
+	// side of the tiles refine renders
+	static constexpr unsigned int refineTile = 16;
+
+	std::vector<Pixel> pixels;
+	unsigned int width;
+	unsigned int height;
+	Matrix<4, 4> transform;	// of the camera the frame was rendered with
+	float fov;
+	unsigned int tracedPixels;
+	unsigned int reprojectedPixels;
+	std::thread refiner;
+	std::unique_ptr<RenderBudget> refineBudget;
+
+public:
+	FrameCache();
+	~FrameCache();
+
+	FrameCache(const FrameCache&) = delete;
+	FrameCache& operator=(const FrameCache&) = delete;
+
+	// The frame seen by camera, reprojected from the last one where possible. Everything is traced if the cache is
+	// empty or the size of the frame changed.
+	Canvas render(const World& world, const Camera& camera);
+	// Renders the tiles with pixels that aren't exact again, with the camera the last frame was rendered with,
+	// until done or the budget expires. completed is the fraction of the frame that is exact.
+	PartialRender refine(const World& world, const Camera& camera, const RenderBudget& budget);
+	// Runs refine on another thread until done or stopped and calls done there with its result. world must stay
+	// alive and unchanged until then, camera is copied.
+	void startRefine(const World& world, const Camera& camera, const std::function<void(const PartialRender&)>& done = nullptr);
+	// cancels a background refine and waits for it
+	void stopRefine();
+	// waits for a background refine to finish
+	void waitForRefine();
+	void invalidate();
+
+	// pixels traced and reprojected by the last render
+	unsigned int getTracedPixels() const;
+	unsigned int getReprojectedPixels() const;
+	// pixels that aren't exact yet
+	unsigned int getPendingPixels() const;
+
+private:
+	// traces the pixels at the indices in todo through their center
+	void trace(const World& world, const Camera& camera, const std::vector<unsigned int>& todo);
+	Canvas image() const;
+};
@@ -0,0 +1,195 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "intersection.h"
+#include "math.h"
+#include "ray.h"
+#include "shape.h"
+#include "trace.h"
+
+// exact comparison, an edit far below the epsilon of operator== still changes the image
+template<typename T>
+static bool same(const T& a, const T& b)
+{
+	return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+static bool sameMaterial(const Material& a, const Material& b)
+{
+	return same(a.ambient, b.ambient) && same(a.diffuse, b.diffuse) && same(a.specular, b.specular) && same(a.shininess, b.shininess)
+		&& same(a.reflective, b.reflective) && same(a.transparency, b.transparency) && same(a.refractiveIndex, b.refractiveIndex)
+		&& same(a.color, b.color) && a.pattern == b.pattern;
+}
+
+static bool sameLight(const Light& a, const Light& b)
+{
+	return same(a.intensity, b.intensity) && same(a.position, b.position) && same(a.constantAttenuation, b.constantAttenuation)
+		&& same(a.linearAttenuation, b.linearAttenuation) && same(a.quadraticAttenuation, b.quadraticAttenuation);
+}
+
+static bool sameAreaLight(const AreaLight& a, const AreaLight& b)
+{
+	return sameLight(a, b) && a.kind == b.kind && same(a.corner, b.corner) && same(a.uvec, b.uvec) && same(a.vvec, b.vvec)
+		&& same(a.radius, b.radius) && a.samples == b.samples;
+}
+
+IncrementalRenderer::IncrementalRenderer(unsigned int tileSize)
+	: tileSize(std::max(1u, tileSize)), tiles(), image(), frame(), objects(), renderedTiles(0)
+{
+}
+
+Canvas IncrementalRenderer::render(const World& world, const Camera& camera)
+{
+	TRACE_SCOPE("render incremental");
+	auto state = capture(world, camera);
+	bool everything = frame == nullptr || !matches(*frame, state) || objects.size() != world.getObjectCount();
+	for (size_t i = 0; !everything && i < objects.size(); i++)
+		everything = objects[i].shape != world.getObject(i);
+
+	if (everything)
+	{
+		build(camera.getWidth(), camera.getHeight());
+		frame = std::make_unique<FrameState>(state);
+	}
+	else
+	{
+		for (size_t i = 0; i < objects.size(); i++)
+			invalidate(world, i);
+	}
+
+	std::vector<Tile*> dirty;
+	for (auto& tile : tiles)
+	{
+		if (tile.dirty)
+			dirty.push_back(&tile);
+	}
+
+	// every tile is rendered on one thread, so the log active on it sees all of its rays
+	auto tileCamera = camera;
+	tileCamera.setThreads(1);
+	std::atomic<size_t> next = 0;
+	camera.runWorkers([&]() {
+		for (size_t i = next++; i < dirty.size(); i = next++)
+		{
+			auto& tile = *dirty[i];
+			tile.log.clear();
+			RayLog::setActive(&tile.log);
+			tileCamera.renderRegion(world, tile.region, *image, tile.region.x, tile.region.y);
+			RayLog::setActive(nullptr);
+
+			std::sort(tile.log.hits.begin(), tile.log.hits.end());
+			tile.dirty = false;
+		}
+	});
+
+	renderedTiles = (unsigned int)dirty.size();
+	capture(world);
+	return *image;
+}
+
+void IncrementalRenderer::invalidate(const Shape& shape)
+{
+	for (auto& tile : tiles)
+	{
+		if (std::binary_search(tile.log.hits.begin(), tile.log.hits.end(), &shape))
+			tile.dirty = true;
+	}
+}
+
+void IncrementalRenderer::invalidate()
+{
+	frame.reset();
+}
+
+unsigned int IncrementalRenderer::getTileCount() const
+{
+	return (unsigned int)tiles.size();
+}
+
+unsigned int IncrementalRenderer::getRenderedTiles() const
+{
+	return renderedTiles;
+}
+
+IncrementalRenderer::FrameState IncrementalRenderer::capture(const World& world, const Camera& camera)
+{
+	return { &world, camera.getWidth(), camera.getHeight(), camera.getFov(), camera.getTransform(), camera.getMaxBounces(), world.lights,
+		world.areaLights, !world.getLightTree().isEmpty(), world.getLightThreshold(), world.getRayThreshold(), world.getRussianRoulette(),
+		world.getSampler() };
+}
+
+bool IncrementalRenderer::matches(const FrameState& a, const FrameState& b)
+{
+	if (a.world != b.world || a.width != b.width || a.height != b.height || !same(a.fov, b.fov) || !same(a.transform, b.transform)
+		|| a.maxBounces != b.maxBounces || a.lightTree != b.lightTree || !same(a.lightThreshold, b.lightThreshold)
+		|| !same(a.rayThreshold, b.rayThreshold) || a.russianRoulette != b.russianRoulette || a.sampler != b.sampler)
+		return false;
+
+	if (a.lights.size() != b.lights.size() || a.areaLights.size() != b.areaLights.size())
+		return false;
+	for (size_t i = 0; i < a.lights.size(); i++)
+	{
+		if (!sameLight(a.lights[i], b.lights[i]))
+			return false;
+	}
+	for (size_t i = 0; i < a.areaLights.size(); i++)
+	{
+		if (!sameAreaLight(a.areaLights[i], b.areaLights[i]))
+			return false;
+	}
+	return true;
+}
+
+void IncrementalRenderer::build(unsigned int width, unsigned int height)
+{
+	if (image == nullptr || image->width != width || image->height != height)
+		image = std::make_unique<Canvas>(width, height);
+
+	tiles.clear();
+	for (unsigned int y = 0; y < height; y += tileSize)
+	{
+		for (unsigned int x = 0; x < width; x += tileSize)
+		{
+			tiles.emplace_back();
+			tiles.back().region = { x, y, std::min(tileSize, width - x), std::min(tileSize, height - y) };
+			tiles.back().dirty = true;
+		}
+	}
+}
+
+void IncrementalRenderer::capture(const World& world)
+{
+	objects.clear();
+	for (size_t i = 0; i < world.getObjectCount(); i++)
+	{
+		auto shape = world.getObject(i);
+		objects.push_back({ shape, shape->transform, *shape->material });
+	}
+}
+
+void IncrementalRenderer::invalidate(const World& world, size_t index)
+{
+	const auto& before = objects[index];
+	const Shape& shape = *world.getObject(index);
+	bool moved = !same<Matrix<4, 4>>(before.transform, shape.transform);
+	if (!moved && sameMaterial(before.material, *shape.material))
+		return;
+
+	invalidate(shape);
+	if (!moved)
+		return;
+
+	// rays that missed the object before and may hit it now, the bounds grow a little against rounding
+	TRACE_SCOPE("find moved object");
+	auto bounds = shape.bounds();
+	bounds.min = bounds.min - Tuple::vector(EPSILON, EPSILON, EPSILON);
+	bounds.max = bounds.max + Tuple::vector(EPSILON, EPSILON, EPSILON);
+	for (auto& tile : tiles)
+	{
+		if (!tile.dirty && tile.log.mayHit(bounds))
+			tile.dirty = true;
+	}
+}
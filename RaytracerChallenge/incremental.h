@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "camera.h"
+#include "canvas.h"
+#include "light.h"
+#include "material.h"
+#include "matrix.h"
+#include "world.h"
+
+class Shape;
+class Sampler;
+
+// Renders a frame in tiles and keeps, per tile, the objects its rays hit and bounds of the space they passed
+// through: camera, reflection and refraction rays as well as shadow rays up to the light or the object blocking them.
+// The next render compares the objects with what they were and renders again only the tiles an edit can change:
+//   - a new material, through the shape or a library shared with others, affects the tiles that hit the object
+//   - a new transform also affects the tiles whose rays the object may now block, those whose bounds overlap
+//     the bounds of the object in its new place
+// Everything is rendered again after the camera, the lights, the settings of the world or the set of objects
+// changed. Changes render can't see, like edits inside a pattern, need invalidate. The image is the same as
+// Camera::render.
+class IncrementalRenderer
+{
+private:
+	struct Tile
+	{
+		Region region;
+		RayLog log;	// hits sorted once the tile is rendered
+		bool dirty;
+	};
+
+	struct ObjectState
+	{
+		const Shape* shape;
+		Matrix<4, 4> transform;
+		Material material;
+	};
+
+	// a change of any of it invalidates every tile
+	struct FrameState
+	{
+		const World* world;
+		unsigned int width;
+		unsigned int height;
+		float fov;
+		Matrix<4, 4> transform;
+		unsigned int maxBounces;
+		std::vector<PointLight> lights;
+		std::vector<AreaLight> areaLights;
+		bool lightTree;
+		float lightThreshold;
+		float rayThreshold;
+		bool russianRoulette;
+		const Sampler* sampler;
+	};
+
+	unsigned int tileSize;
+	std::vector<Tile> tiles;
+	std::unique_ptr<Canvas> image;
+	std::unique_ptr<FrameState> frame;
+	std::vector<ObjectState> objects;
+	unsigned int renderedTiles;
+
+public:
+	explicit IncrementalRenderer(unsigned int tileSize = 16);
+
+	// Renders the tiles changed since the last render and returns the whole frame. Tiles are handed out to the
+	// threads of the camera. The antialiasing settings and sampler of the camera are not compared, call invalidate
+	// after changing them.
+	Canvas render(const World& world, const Camera& camera);
+	// The tiles that touched shape are rendered again by the next render.
+	void invalidate(const Shape& shape);
+	// Everything is rendered again by the next render.
+	void invalidate();
+
+	unsigned int getTileCount() const;
+	// tiles rendered by the last render
+	unsigned int getRenderedTiles() const;
+
+private:
+	static FrameState capture(const World& world, const Camera& camera);
+	static bool matches(const FrameState& a, const FrameState& b);
+	void build(unsigned int width, unsigned int height);
+	void capture(const World& world);
+	// marks the tiles a change of the object at index can affect
+	void invalidate(const World& world, size_t index);
+};
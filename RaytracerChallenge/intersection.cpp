@@ -1,6 +1,7 @@
 #include "intersection.h"
 
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 
 #include "math.h"
@@ -8,9 +9,10 @@
 #include "ray.h"
 #include "world.h"
 #include "material.h"
+#include "stats.h"
 
-Computations::Computations(float t, const Shape* object, const Ray& ray, const Tuple& normal, const Intersections& xs)
-	: t(t), object(object), point(ray.pos(t)), eyev(-ray.direction), normal(normal), inside(false), n1(1.f), n2(1.f)
+Computations::Computations(float t, const Shape* object, const Ray& ray, const Tuple& normal)
+	: t(t), object(object), point(ray.pos(t)), eyev(-ray.direction), normal(normal), n1(1.f), n2(1.f), inside(false), flags(0)
 {
 	if (dot(normal, eyev) < 0.f)
 	{
@@ -19,56 +21,182 @@ Computations::Computations(float t, const Shape* object, const Ray& ray, const T
 	}
 
 	overPoint = point + this->normal * EPSILON;
-	reflectv = reflect(ray.direction, this->normal);
-	underPoint = point - this->normal * EPSILON;
+
+	// below EPSILON the secondary ray isn't traced, the same as in reflectedColor and refractedColor
+	const Material& material = *object->material;
+	if (material.reflective >= EPSILON)
+		flags |= Reflects;
+	if (material.transparency >= EPSILON)
+		flags |= Refracts;
+}
+
+Tuple Computations::reflectv() const
+{
+	return reflect(-eyev, normal);
+}
+
+Tuple Computations::underPoint() const
+{
+	return point - normal * EPSILON;
+}
+
+Ray Computations::spawnRay(const Tuple& direction) const
+{
+	bool above = dot(direction, normal) >= 0.f;
+	// normal points towards the eye, so the ray heads into the object if it goes below the surface while
+	// hitting it from outside or above it from inside
+	bool into = above == inside;
+
+	// the offset alone fails where EPSILON is too small for the scale of the scene, World::intersect skips a
+	// convex source as well
+	return Ray(above ? overPoint : underPoint(), direction, object, into);
+}
+
+// diffuse + specular of a light scaled by how much of the light is visible from the hit
+static Color visibleDirect(const World& w, const Light& light, const Computations& comps, const Color& direct, std::vector<ShadowRay>* shadowRays)
+{
+	// lights that cannot visibly change the result don't get a shadow ray
+	if (maxComponent(direct) < w.getLightThreshold())
+		return Color(0);
+
+	if (shadowRays != nullptr && light.getSamples() <= 1)
+	{
+		auto direction = light.position - comps.point;
+		auto distance = length(direction);
+		shadowRays->push_back({ comps.spawnRay(direction / distance), distance, direct });
+		return Color(0);
+	}
+
+	return direct * w.visibility(comps, light);
 }
 
 Color Computations::shade(const World& w, unsigned int remaining) const
 {
-	bool isShadowed = w.isShadowed(overPoint);
+	return surfaceColor(w) + w.traceSecondary(*this, remaining);
+}
+
+Color Computations::surfaceColor(const World& w, std::vector<ShadowRay>* shadowRays) const
+{
+	const Material& material = *object->material;
+
+	const Color color = material.colorAt(*object, overPoint);
+	const auto& tree = w.getLightTree();
 
-	auto surface = object->material.lighting(*object, w.light, overPoint, eyev, normal, isShadowed);
+	auto surface = Color(0);
+	if (tree.isEmpty())
+	{
+		for (const auto& light : w.lights)
+		{
+			auto terms = material.lightingTerms(color, light, overPoint, eyev, normal);
+			surface = surface + terms.ambient + visibleDirect(w, light, *this, terms.direct, shadowRays);
+		}
+	}
+	else
+	{
+		// the ambient part of all lights together only depends on their summed intensity
+		surface = color * tree.getIntensity() * material.ambient;
+
+		// upper bound of diffuse + specular per unit of light intensity
+		float scale = material.diffuse * (material.pattern != nullptr ? 1.f : maxComponent(material.color)) + material.specular;
+		if (scale > 0.f)
+		{
+			thread_local std::vector<unsigned int> selected;
+			selected.clear();
+			tree.collect(overPoint, normal, w.getLightThreshold() / scale, selected);
+
+			for (auto index : selected)
+			{
+				const auto& light = w.lights[index];
+				auto terms = material.lightingTerms(color, light, overPoint, eyev, normal);
+				surface = surface + visibleDirect(w, light, *this, terms.direct, shadowRays);
+			}
+		}
+	}
+
+	// area lights are not part of the light tree
+	for (const auto& light : w.areaLights)
+	{
+		auto terms = material.lightingTerms(color, light, overPoint, eyev, normal);
+		surface = surface + terms.ambient + visibleDirect(w, light, *this, terms.direct, shadowRays);
+	}
+
+	return surface;
+}
+
+void Computations::spawn(float weight, unsigned int remaining, std::vector<PendingRay>& rays) const
+{
+	if (remaining < 1 || flags == 0)
+		return;
+
+	const Material& material = *object->material;
+	bool reflects = (flags & Reflects) != 0;
+	bool refracts = (flags & Refracts) != 0;
+
+	float reflectance = 1.f;
+	float transmittance = 1.f;
+	if (flags == (Reflects | Refracts))
+	{
+		reflectance = schlick();
+		transmittance = 1.f - reflectance;
+	}
 
-	auto reflected = reflectedColor(w, remaining);
-	auto refracted = refractedColor(w, remaining);
+	auto stats = RenderStats::active();
 
-	if (object->material.reflective > 0.f && object->material.transparency > 0.f)
+	Ray refractRay;
+	if (refracts && refractedRay(refractRay))
 	{
-		auto reflectance = schlick();
-		return surface + reflected * reflectance + refracted * (1.f - reflectance);
+		rays.push_back({ refractRay, weight * material.transparency * transmittance, remaining - 1 });
+		if (stats != nullptr)
+			stats->refractionRays++;
 	}
 
-	return surface + reflected + refracted;
+	if (reflects)
+	{
+		rays.push_back({ spawnRay(reflectv()), weight * material.reflective * reflectance, remaining - 1 });
+		if (stats != nullptr)
+			stats->reflectionRays++;
+	}
 }
 
 Color Computations::reflectedColor(const World& w, unsigned int remaining) const
 {
-	if (object->material.reflective < EPSILON || remaining < 1)
+	if (object->material->reflective < EPSILON || remaining < 1)
 		return Color(0);
 
-	auto reflectRay = Ray(overPoint, reflectv);
+	auto reflectRay = spawnRay(reflectv());
+	if (auto stats = RenderStats::active())
+		stats->reflectionRays++;
 	auto color = w.colorAt(reflectRay, remaining - 1);
 
-	return color * object->material.reflective;
+	return color * object->material->reflective;
 }
 
 Color Computations::refractedColor(const World& w, unsigned int remaining) const
 {
-	if (object->material.transparency < EPSILON || remaining < 1)
+	if (object->material->transparency < EPSILON || remaining < 1)
 		return Color(0);
 
+	Ray refractRay;
+	if (!refractedRay(refractRay))
+		return Color(0);
+	if (auto stats = RenderStats::active())
+		stats->refractionRays++;
+
+	return w.colorAt(refractRay, remaining - 1) * object->material->transparency;
+}
+
+bool Computations::refractedRay(Ray& ray) const
+{
 	auto nRatio = n1 / n2;
 	auto cosi = dot(eyev, normal);
 	auto sin2t = nRatio * nRatio * (1.f - cosi * cosi);
 	if (sin2t > 1.f) // total internal reflection
-		return Color(0);
+		return false;
 
 	auto cost = sqrtf(1.f - sin2t);
 	auto direction = normal * (nRatio * cosi - cost) - eyev * nRatio;
-	auto refractRay = Ray(underPoint, direction);
-
-	return w.colorAt(refractRay, remaining - 1) * object->material.transparency;
-
+	ray = spawnRay(direction);
+	return true;
 }
 
 float Computations::schlick() const
@@ -99,44 +227,51 @@ Intersection::Intersection(float t, const Shape* primitive)
 
 Computations Intersection::prepare(const Ray& ray) const
 {
-	return prepare(ray, Intersections{ *this });
+	return prepare(ray, this, this + 1);
 }
 
 Computations Intersection::prepare(const Ray& ray, const Intersections& xs) const
 {
-	Computations comps(t, primitive, ray, primitive->normal(ray.pos(t)), xs);
-	std::vector<const Shape*> containers;
+	return prepare(ray, xs.data(), xs.data() + xs.count());
+}
 
-	for (const auto& i : xs)
+Computations Intersection::prepare(const Ray& ray, const Intersection* begin, const Intersection* end) const
+{
+	Computations comps(t, primitive, ray, primitive->normal(ray.pos(t)));
+
+	// n1 and n2 only feed refraction and schlick, both need a transparent hit
+	if ((comps.flags & Computations::Refracts) == 0)
+		return comps;
+
+	// objects the ray is inside of, deeper nesting than this is ignored
+	const int capacity = 32;
+	const Shape* containers[capacity];
+	int count = 0;
+
+	for (auto i = begin; i != end; i++)
 	{
-		if (i == *this)
+		bool isHit = *i == *this;
+		if (isHit)
+			comps.n1 = count == 0 ? 1.f : containers[count - 1]->material->refractiveIndex;
+
+		int found = count - 1;
+		while (found >= 0 && containers[found] != i->primitive)
+			found--;
+
+		if (found >= 0)
 		{
-			if (containers.empty())
-			{
-				comps.n1 = 1.f;
-			}
-			else
-			{
-				comps.n1 = containers.back()->material.refractiveIndex;
-			}
+			for (int j = found; j < count - 1; j++)
+				containers[j] = containers[j + 1];
+			count--;
+		}
+		else if (count < capacity)
+		{
+			containers[count++] = i->primitive;
 		}
 
-		auto it = containers.end();
-		if ((it = std::find(containers.begin(), containers.end(), i.primitive)) != containers.end())
-			containers.erase(it);
-		else
-			containers.push_back(i.primitive);
-
-		if (i == *this)
+		if (isHit)
 		{
-			if (containers.empty())
-			{
-				comps.n2 = 1.f;
-			}
-			else
-			{
-				comps.n2 = containers.back()->material.refractiveIndex;
-			}
+			comps.n2 = count == 0 ? 1.f : containers[count - 1]->material->refractiveIndex;
 			break;
 		}
 	}
@@ -169,9 +304,18 @@ std::wstring ToString(const Intersection* i)
 	return ToString(*i);
 }
 
+// counts the allocation growing a list of capacity to size will make
+static void countAllocation(size_t size, size_t capacity)
+{
+	auto stats = RenderStats::active();
+	if (stats != nullptr && size > capacity)
+		stats->intersectionsAllocations++;
+}
+
 Intersections::Intersections(std::initializer_list<Intersection> il)
 	: intersections(il)
 {
+	countAllocation(il.size(), 0);
 }
 
 size_t Intersections::count() const
@@ -190,6 +334,27 @@ const Intersection* Intersections::hit() const
 	return ret;
 }
 
+void Intersections::append(const Intersections& rhs)
+{
+	countAllocation(intersections.size() + rhs.intersections.size(), intersections.capacity());
+	intersections.insert(intersections.end(), rhs.intersections.begin(), rhs.intersections.end());
+}
+
+void Intersections::sort()
+{
+	std::sort(intersections.begin(), intersections.end(), [](const auto& l, const auto& r) { return l.t < r.t; });
+}
+
+void Intersections::clear()
+{
+	intersections.clear();
+}
+
+const Intersection* Intersections::data() const
+{
+	return intersections.data();
+}
+
 std::vector<Intersection>::iterator Intersections::begin()
 {
 	return intersections.begin();
@@ -222,6 +387,7 @@ Intersection& Intersections::operator[](int i)
 
 Intersections& Intersections::operator+=(const Intersections& rhs)
 {
+	countAllocation(intersections.size() + rhs.intersections.size(), intersections.capacity());
 	for (auto i : rhs.intersections)
 		intersections.push_back(i);
 	std::sort(intersections.begin(), intersections.end(), [](const auto& l, const auto& r) { return l.t < r.t; });
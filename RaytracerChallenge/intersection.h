@@ -4,33 +4,71 @@
 
 #include "math.h"
 #include "color.h"
+#include "ray.h"
 
 
 class Shape;
-class Ray;
 class World;
 class Intersections;
 
+// A ray waiting to be traced and how much its color counts towards the pixel.
+struct PendingRay
+{
+	Ray ray;
+	float weight;
+	unsigned int remaining;
+};
+
+// A shadow ray towards a point light and the light that arrives if nothing is hit before distance.
+struct ShadowRay
+{
+	Ray ray;
+	float distance;
+	Color light;
+};
+
+// Only what every hit needs is stored, the rest is derived on demand. Which secondary rays a hit spawns
+// (and whether n1 and n2 are computed at all) is decided once from the material flags.
 struct Computations
 {
+	enum Flags : unsigned char
+	{
+		Reflects = 1,
+		Refracts = 2
+	};
+
 	float t;
 	const Shape* object;
 	Tuple point;
 	Tuple eyev;
 	Tuple normal;
-	bool inside;
 	Tuple overPoint;
-	Tuple reflectv;
 	float n1;
 	float n2;
-	Tuple underPoint;
+	bool inside;
+	unsigned char flags;
+
+	Computations(float t, const Shape* object, const Ray& ray, const Tuple& normal);
 
-	Computations(float t, const Shape* object, const Ray& ray, const Tuple& normal, const Intersections& xs);
+	Tuple reflectv() const;
+	Tuple underPoint() const;
+	// A ray leaving the hit from overPoint or underPoint. Traversal skips a convex object it leaves and only
+	// hits the far side of a closed one it heads into.
+	Ray spawnRay(const Tuple& direction) const;
 
 	Color shade(const World& w, unsigned int remaining) const;
+	// Lighting of the surface itself, without reflection and refraction. If shadowRays isn't null, point lights
+	// are left out of the result and queued there with their shadow ray instead of being tested.
+	Color surfaceColor(const World& w, std::vector<ShadowRay>* shadowRays = nullptr) const;
+	// Queues the reflected and refracted rays of this hit with their weights relative to the pixel.
+	void spawn(float weight, unsigned int remaining, std::vector<PendingRay>& rays) const;
 	Color reflectedColor(const World& w, unsigned int remaining) const;
 	Color refractedColor(const World& w, unsigned int remaining) const;
 	float schlick() const;
+
+private:
+	// returns false under total internal reflection
+	bool refractedRay(Ray& ray) const;
 };
 
 class Intersection
@@ -51,6 +89,9 @@ public:
 
 	friend std::wstring ToString(const Intersection& i);
 	friend std::wstring ToString(const Intersection* i);
+
+private:
+	Computations prepare(const Ray& ray, const Intersection* begin, const Intersection* end) const;
 };
 
 class Intersections
@@ -64,10 +105,16 @@ public:
 	size_t count() const;
 	const Intersection* hit() const;
 
+	// append without keeping the list sorted, call sort() once done
+	void append(const Intersections& rhs);
+	void sort();
+	void clear();
+
 	std::vector<Intersection>::iterator begin();
 	std::vector<Intersection>::const_iterator begin() const;
 	std::vector<Intersection>::iterator end();
 	std::vector<Intersection>::const_iterator end() const;
+	const Intersection* data() const;
 
 	const Intersection& operator[](int i) const;
 	Intersection& operator[](int i);
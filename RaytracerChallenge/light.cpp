@@ -1,10 +1,28 @@
 #include "light.h"
 
 #include <sstream>
+#include <cmath>
+
+#include "math.h"
 
 Light::Light(const Tuple& position, const Color& intensity)
-	: position(position), intensity(intensity)
+	: position(position), intensity(intensity), constantAttenuation(1.f), linearAttenuation(0.f), quadraticAttenuation(0.f)
+{
+}
+
+float Light::attenuation(float distance) const
+{
+	return 1.f / (constantAttenuation + linearAttenuation * distance + quadraticAttenuation * distance * distance);
+}
+
+Tuple Light::pointOn(float, float, const Tuple&) const
+{
+	return position;
+}
+
+unsigned int Light::getSamples() const
 {
+	return 1;
 }
 
 bool Light::operator==(const Light& rhs) const
@@ -28,3 +46,67 @@ std::wstring ToString(const PointLight& l)
 	ss << "PointLight at " << ToString(l.position) << " with intensity " << ToString(l.intensity);
 	return std::wstring();
 }
+
+AreaLight::AreaLight(Kind kind, const Tuple& position, const Color& intensity, unsigned int samples)
+	: Light(position, intensity), kind(kind), corner(position), uvec(Tuple::vector(0, 0, 0)), vvec(Tuple::vector(0, 0, 0)), radius(0.f), samples(samples)
+{
+}
+
+AreaLight AreaLight::rectangle(const Tuple& corner, const Tuple& uvec, const Tuple& vvec, const Color& intensity, unsigned int samples)
+{
+	AreaLight l(Kind::Rectangle, corner + (uvec + vvec) * 0.5f, intensity, samples);
+	l.corner = corner;
+	l.uvec = uvec;
+	l.vvec = vvec;
+	return l;
+}
+
+AreaLight AreaLight::sphere(const Tuple& center, float radius, const Color& intensity, unsigned int samples)
+{
+	AreaLight l(Kind::Sphere, center, intensity, samples);
+	l.radius = radius;
+	return l;
+}
+
+Tuple AreaLight::pointOn(float u, float v, const Tuple& from) const
+{
+	if (kind == Kind::Rectangle)
+		return corner + uvec * u + vvec * v;
+
+	// a sphere looks like a disk facing the shaded point, map the square concentrically onto it
+	auto axis = normalize(position - from);
+	auto helper = fabsf(axis.x) > 0.9f ? Tuple::vector(0, 1, 0) : Tuple::vector(1, 0, 0);
+	auto a = normalize(cross(axis, helper));
+	auto b = cross(axis, a);
+
+	float x = 2.f * u - 1.f;
+	float y = 2.f * v - 1.f;
+	if (x == 0.f && y == 0.f)
+		return position;
+
+	float r;
+	float phi;
+	if (fabsf(x) > fabsf(y))
+	{
+		r = x;
+		phi = pi / 4.f * (y / x);
+	}
+	else
+	{
+		r = y;
+		phi = pi / 2.f - pi / 4.f * (x / y);
+	}
+
+	return position + (a * cosf(phi) + b * sinf(phi)) * (r * radius);
+}
+
+unsigned int AreaLight::getSamples() const
+{
+	return samples;
+}
+
+bool AreaLight::operator==(const Light& rhs) const
+{
+	const AreaLight* l = dynamic_cast<const AreaLight*>(&rhs);
+	return l != nullptr && Light::operator==(rhs) && kind == l->kind && corner == l->corner && uvec == l->uvec && vvec == l->vvec && areEqual(radius, l->radius);
+}
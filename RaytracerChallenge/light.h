@@ -8,11 +8,22 @@ class Light
 public:
 	Color intensity;
 	Tuple position;
+	// 1 / (constant + linear * d + quadratic * d^2), the default of (1, 0, 0) does not attenuate
+	float constantAttenuation = 1.f;
+	float linearAttenuation = 0.f;
+	float quadraticAttenuation = 0.f;
 
 public:
 	Light() = default;
 	Light(const Tuple& position, const Color& intensity);
 
+	float attenuation(float distance) const;
+
+	// Point on the light for the sample (u, v) in [0, 1)^2 as seen from a shaded point. Point lights only have their position.
+	virtual Tuple pointOn(float u, float v, const Tuple& from) const;
+	// Shadow samples along each axis, 1 for hard shadows
+	virtual unsigned int getSamples() const;
+
 	virtual bool operator==(const Light& rhs) const;
 };
 
@@ -27,3 +38,33 @@ public:
 	friend std::wstring ToString(const PointLight& l);
 };
 
+class AreaLight : public Light
+{
+public:
+	enum class Kind
+	{
+		Rectangle,
+		Sphere
+	};
+
+	Kind kind;
+	Tuple corner;
+	Tuple uvec;
+	Tuple vvec;
+	float radius;
+	unsigned int samples;
+
+public:
+	// position is the center of the rectangle spanned by uvec and vvec from corner
+	static AreaLight rectangle(const Tuple& corner, const Tuple& uvec, const Tuple& vvec, const Color& intensity, unsigned int samples = 4);
+	static AreaLight sphere(const Tuple& center, float radius, const Color& intensity, unsigned int samples = 4);
+
+	virtual Tuple pointOn(float u, float v, const Tuple& from) const override;
+	virtual unsigned int getSamples() const override;
+
+	virtual bool operator==(const Light& rhs) const;
+
+private:
+	AreaLight(Kind kind, const Tuple& position, const Color& intensity, unsigned int samples);
+};
+
@@ -0,0 +1,189 @@
+#include "lighttree.h"
+
+#include <algorithm>
+#include <cmath>
+
+static float component(const Tuple& t, int axis)
+{
+	if (axis == 0)
+		return t.x;
+	if (axis == 1)
+		return t.y;
+	return t.z;
+}
+
+void LightTree::build(const std::vector<PointLight>& lights)
+{
+	clear();
+	if (lights.empty())
+		return;
+
+	order.resize(lights.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	nodes.reserve(2 * lights.size() - 1);
+	buildNode(lights, 0, (unsigned int)lights.size());
+}
+
+void LightTree::clear()
+{
+	nodes.clear();
+	order.clear();
+}
+
+bool LightTree::isEmpty() const
+{
+	return nodes.empty();
+}
+
+size_t LightTree::getLightCount() const
+{
+	return order.size();
+}
+
+const Color& LightTree::getIntensity() const
+{
+	return nodes.front().intensity;
+}
+
+unsigned int LightTree::buildNode(const std::vector<PointLight>& lights, unsigned int begin, unsigned int end)
+{
+	unsigned int index = (unsigned int)nodes.size();
+	nodes.push_back(Node());
+
+	Node node;
+	const auto& firstLight = lights[order[begin]];
+	node.min = firstLight.position;
+	node.max = firstLight.position;
+	node.intensity = Color(0);
+	node.constantAttenuation = firstLight.constantAttenuation;
+	node.linearAttenuation = firstLight.linearAttenuation;
+	node.quadraticAttenuation = firstLight.quadraticAttenuation;
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const auto& light = lights[order[i]];
+		node.min = Tuple::point(std::min(node.min.x, light.position.x), std::min(node.min.y, light.position.y), std::min(node.min.z, light.position.z));
+		node.max = Tuple::point(std::max(node.max.x, light.position.x), std::max(node.max.y, light.position.y), std::max(node.max.z, light.position.z));
+		node.intensity = node.intensity + light.intensity;
+		node.constantAttenuation = std::min(node.constantAttenuation, light.constantAttenuation);
+		node.linearAttenuation = std::min(node.linearAttenuation, light.linearAttenuation);
+		node.quadraticAttenuation = std::min(node.quadraticAttenuation, light.quadraticAttenuation);
+	}
+
+	if (end - begin == 1)
+	{
+		node.first = begin;
+		node.count = 1;
+		node.skip = index + 1;
+		nodes[index] = node;
+		return index;
+	}
+
+	// split at the median along the longest axis of the bounds
+	auto extent = node.max - node.min;
+	int axis = 0;
+	if (extent.y > extent.x)
+		axis = 1;
+	if (extent.z > component(extent, axis))
+		axis = 2;
+
+	unsigned int mid = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](unsigned int a, unsigned int b) {
+		return component(lights[a].position, axis) < component(lights[b].position, axis);
+	});
+
+	buildNode(lights, begin, mid);
+	node.first = buildNode(lights, mid, end);
+	node.count = 0;
+	node.skip = (unsigned int)nodes.size();
+	nodes[index] = node;
+	return index;
+}
+
+float LightTree::importance(const Node& node, const Tuple& point, const Tuple& normal) const
+{
+	// lights completely below the surface can't light it
+	bool above = false;
+	for (int i = 0; i < 8 && !above; i++)
+	{
+		auto corner = Tuple::point(i & 1 ? node.max.x : node.min.x, i & 2 ? node.max.y : node.min.y, i & 4 ? node.max.z : node.min.z);
+		above = dot(corner - point, normal) > 0.f;
+	}
+	if (!above)
+		return 0.f;
+
+	// closest distance between the point and the bounds
+	float dx = std::max(std::max(node.min.x - point.x, point.x - node.max.x), 0.f);
+	float dy = std::max(std::max(node.min.y - point.y, point.y - node.max.y), 0.f);
+	float dz = std::max(std::max(node.min.z - point.z, point.z - node.max.z), 0.f);
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+	float attenuation = 1.f / (node.constantAttenuation + node.linearAttenuation * distance + node.quadraticAttenuation * distance * distance);
+	return maxComponent(node.intensity) * attenuation;
+}
+
+void LightTree::collect(const Tuple& point, const Tuple& normal, float threshold, std::vector<unsigned int>& lights) const
+{
+	if (nodes.empty())
+		return;
+
+	// nodes are stored depth first, so a subtree is skipped by jumping past it
+	unsigned int index = 0;
+	while (index < nodes.size())
+	{
+		const auto& node = nodes[index];
+		if (importance(node, point, normal) < threshold)
+		{
+			index = node.skip;
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+				lights.push_back(order[i]);
+			index = node.skip;
+			continue;
+		}
+
+		index = index + 1;
+	}
+}
+
+int LightTree::sample(const Tuple& point, const Tuple& normal, float u, float& pdf) const
+{
+	pdf = 0.f;
+	if (nodes.empty() || importance(nodes.front(), point, normal) <= 0.f)
+		return -1;
+
+	pdf = 1.f;
+	unsigned int index = 0;
+	while (nodes[index].count == 0)
+	{
+		float left = importance(nodes[index + 1], point, normal);
+		float right = importance(nodes[nodes[index].first], point, normal);
+		// the bound of the parent can reach the point where those of both children don't
+		if (left + right <= 0.f)
+		{
+			pdf = 0.f;
+			return -1;
+		}
+		float pLeft = left / (left + right);
+
+		if (u < pLeft)
+		{
+			u = u / pLeft;
+			pdf *= pLeft;
+			index = index + 1;
+		}
+		else
+		{
+			u = (u - pLeft) / (1.f - pLeft);
+			pdf *= 1.f - pLeft;
+			index = nodes[index].first;
+		}
+	}
+
+	return (int)order[nodes[index].first];
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "tuple.h"
+#include "color.h"
+#include "light.h"
+
+// Bounding volume hierarchy over light positions. Every node bounds the positions, the summed intensity and the
+// weakest attenuation of the lights below it, which gives an upper bound for what the subtree can add at a point.
+class LightTree
+{
+private:
+	struct Node
+	{
+		Tuple min;
+		Tuple max;
+		Color intensity;
+		float constantAttenuation;
+		float linearAttenuation;
+		float quadraticAttenuation;
+		unsigned int first;	// leaf: first entry in order, inner node: index of the second child (the first one follows the node)
+		unsigned int count;	// number of lights in a leaf, 0 for inner nodes
+		unsigned int skip;	// index of the node after the subtree, where traversal continues without it
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> order;
+
+public:
+	LightTree() = default;
+
+	void build(const std::vector<PointLight>& lights);
+	void clear();
+
+	bool isEmpty() const;
+	size_t getLightCount() const;
+	const Color& getIntensity() const;
+
+	// Appends the index of every light whose bound at point is at least threshold.
+	void collect(const Tuple& point, const Tuple& normal, float threshold, std::vector<unsigned int>& lights) const;
+	// Picks one light with a probability proportional to the bound of its subtrees, u is uniform in [0, 1).
+	// Returns -1 if no light can reach the point.
+	int sample(const Tuple& point, const Tuple& normal, float u, float& pdf) const;
+
+private:
+	unsigned int buildNode(const std::vector<PointLight>& lights, unsigned int begin, unsigned int end);
+	float importance(const Node& node, const Tuple& point, const Tuple& normal) const;
+};
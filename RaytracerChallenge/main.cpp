@@ -1,8 +1,13 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 
+#ifdef _WIN32
 #include <Shlwapi.h>
+#endif
 
 #include "tuple.h"
 #include "canvas.h"
@@ -14,6 +19,9 @@
 #include "camera.h"
 #include "world.h"
 #include "pattern.h"
+#include "scenes.h"
+#include "trace.h"
+#include "distributed.h"
 
 struct projectile
 {
@@ -136,7 +144,7 @@ void rayCaster()
 
 	auto shape = Sphere();
 	shape.material = Material();
-	shape.material.color = Color(1, 0.2f, 1);
+	shape.material->color = Color(1, 0.2f, 1);
 	//shape.transform = scaling(1, 0.5, 1);
 	//shape.transform = scaling(0.5, 1, 1);
 	//shape.transform = rotationZ(pi / 4) * scaling(0.5, 1, 1);
@@ -161,7 +169,7 @@ void rayCaster()
 				auto point = ray.pos(hit->t);
 				auto normal = hit->primitive->normal(point);
 				auto eye = -ray.direction;
-				Color color = hit->primitive->material.lighting(*hit->primitive, light, point, eye, normal, false);
+				Color color = hit->primitive->material->lighting(*hit->primitive, light, point, eye, normal, false);
 				canvas.writePixel(x, y, color);
 			}
 		}
@@ -169,254 +177,142 @@ void rayCaster()
 	canvas.savePPM("canvas.ppm");
 }
 
+void showCanvas()
+{
+#ifdef _WIN32
+	ShellExecute(NULL, NULL, L"canvas.ppm", NULL, NULL, SW_SHOW);
+#endif
+}
+
 // chapter 7
 void simpleWorld()
 {
-	auto floor = Sphere();
-	floor.transform = scaling(10, 0.01f, 10);
-	floor.material = Material();
-	floor.material.color = Color(1, 0.9f, 0.9f);
-	floor.material.specular = 0;
-
-	auto leftWall = Sphere();
-	leftWall.transform = translation(0, 0, 5) * rotationY(-pi / 4) * rotationX(pi / 2) * scaling(10, 0.1f, 10);
-	leftWall.material = floor.material;
-
-	auto rightWall = Sphere();
-	rightWall.transform = translation(0, 0, 5) * rotationY(pi / 4) * rotationX(pi / 2) * scaling(10, 0.1f, 10);
-	rightWall.material = floor.material;
-
-	auto middle = Sphere();
-	middle.transform = translation(-0.5f, 1, 0.5f) * scaling(0.6f, 0.4f, 2.0f);
-	middle.material = Material();
-	middle.material.color = Color(0.1f, 1, 0.5f);
-	middle.material.diffuse = 0.7;
-	middle.material.specular = 0.3;
-
-	auto right = Sphere();
-	right.transform = translation(1.5f, 0.5f, -0.5f) * scaling(0.5f, 0.5f, 0.5f);
-	right.material = Material();
-	right.material.color = Color(0.5f, 1, 0.1f);
-	right.material.diffuse = 0.7f;
-	right.material.specular = 0.3f;
-
-	auto left = Sphere();
-	left.transform = translation(-1.5, 0.33, -0.75) * scaling(0.33, 0.33, 0.33);
-	left.material = Material();
-	left.material.color = Color(1, 0.8, 0.1);
-	left.material.diffuse = 0.7;
-	left.material.specular = 0.3;
-
-	auto world = World();
-	world.light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
-	world.addObject(&floor);
-	world.addObject(&leftWall);
-	world.addObject(&rightWall);
-	world.addObject(&middle);
-	world.addObject(&left);
-	world.addObject(&right);
-
-	auto camera = Camera(800, 400, pi / 3);
-	camera.setTransform(viewTransform(Tuple::point(0, 1.5f, -5), Tuple::point(0, 1, 0), Tuple::point(0, 1, 0)));
-
-	auto canvas = camera.render(world);
+	auto scene = Scene::simpleWorld();
+	auto camera = scene->camera(800, 400);
+
+	auto canvas = camera.render(scene->world);
 	canvas.savePPM("canvas.ppm");
 }
 
 // chapter 9
 void worldWithPlanes()
 {
-	auto floor = Plane();
-	//floor.transform = scaling(10, 0.01, 10);
-	floor.material = Material();
-	floor.material.color = Color(1, 0.9f, 0.9f);
-	floor.material.specular = 0;
-
-	auto leftWall = Plane();
-	leftWall.transform = translation(0, 0, 5) * rotationY(-pi / 4) * rotationX(pi / 2);
-	leftWall.material = floor.material;
-
-	auto rightWall = Plane();
-	rightWall.transform = translation(0, 0, 5) * rotationY(pi / 4) * rotationX(pi / 2);
-	rightWall.material = floor.material;
-
-	auto middle = Sphere();
-	middle.transform = translation(-0.5, 1, 0.5) * scaling(0.6, 0.4, 2.0);
-	middle.material = Material();
-	middle.material.color = Color(0.1, 1, 0.5);
-	middle.material.diffuse = 0.7;
-	middle.material.specular = 0.3;
-
-	auto right = Sphere();
-	right.transform = translation(1.5, 0.5, -0.5) * scaling(0.5, 0.5, 0.5);
-	right.material = Material();
-	right.material.color = Color(0.5, 1, 0.1);
-	right.material.diffuse = 0.7;
-	right.material.specular = 0.3;
-
-	auto left = Sphere();
-	left.transform = translation(-1.5, 0.33, -0.75) * scaling(0.33, 0.33, 0.33);
-	left.material = Material();
-	left.material.color = Color(1, 0.8, 0.1);
-	left.material.diffuse = 0.7;
-	left.material.specular = 0.3;
-
-	auto world = World();
-	world.light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
-	world.addObject(&floor);
-	world.addObject(&leftWall);
-	world.addObject(&rightWall);
-	world.addObject(&middle);
-	world.addObject(&left);
-	world.addObject(&right);
-
-	auto camera = Camera(800, 400, pi / 3);
-	camera.setTransform(viewTransform(Tuple::point(0, 1.5, -5), Tuple::point(0, 1, 0), Tuple::point(0, 1, 0)));
-
-	auto canvas = camera.render(world);
+	auto scene = Scene::worldWithPlanes();
+	auto camera = scene->camera(800, 400);
+
+	auto canvas = camera.render(scene->world);
 	canvas.savePPM("canvas.ppm");
 
-	ShellExecute(NULL, NULL, L"canvas.ppm", NULL, NULL, SW_SHOW);
+	showCanvas();
 }
 
 // chapter 10 / 11
 void worldWithPatterns()
 {
-	auto floor = Plane();
-	auto fPattern = CheckersPattern(Color(1, 1, 1), Color(0, 0, 0));
-	fPattern.transform = translation(0, -0.1, 0) * rotationY(pi / 4) * scaling(2, 2, 2);
-	floor.material = Material();
-	floor.material.specular = 0;
-	floor.material.pattern = &fPattern;
-
-	auto leftWall = Plane();
-	auto lwPattern = RingPattern(Color(1, 1, 1), Color(1, 0, 0));
-	//lwPattern.transform = rotationX(pi / 2) * translation(0, 0, 5);
-	leftWall.transform = translation(0, 0, 4.9) * rotationY(-pi / 4) * rotationX(pi / 2);
-	leftWall.material = floor.material;
-	leftWall.material.pattern = &lwPattern;
-
-	auto rightWall = Plane();
-	rightWall.transform = translation(0, 0, 4.9) * rotationY(pi / 4) * rotationX(pi / 2);
-	rightWall.material = floor.material;
-	rightWall.material.ambient = 0.f;
-	rightWall.material.diffuse = 0.f;
-	rightWall.material.reflective = 0.8f;
-	rightWall.material.pattern = nullptr;
-
-	auto middle = Sphere();
-	auto sPattern = StripePattern(Color(1, 0.5, 0), Color(1, 0.3, 0));
-	sPattern.transform = rotationZ(pi / 2) * scaling(0.05, 0.05, 0.05);
-	middle.transform = translation(-0.5, 1, 0.5) * scaling(0.6, 0.4, 2.0);
-	middle.material = Material();
-	middle.material.color = Color(0.1, 1, 0.5);
-	middle.material.diffuse = 0.7;
-	middle.material.specular = 0.3;
-	middle.material.pattern = &sPattern;
-
-	auto right = Sphere();
-	right.transform = translation(1.5, 0.5, -0.5) * scaling(0.5, 0.5, 0.5);
-	right.material = Material();
-	right.material.color = Color(0.5, 1, 0.1);
-	right.material.diffuse = 0.7;
-	right.material.specular = 0.3;
-
-	auto left = Sphere();
-	left.transform = translation(-1.5, 0.33, -0.75) * scaling(0.33, 0.33, 0.33);
-	left.material = Material();
-	left.material.color = Color(1, 0.8, 0.1);
-	left.material.diffuse = 0.7;
-	left.material.specular = 0.3;
-
-	auto world = World();
-	world.light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
-	world.addObject(&floor);
-	world.addObject(&leftWall);
-	world.addObject(&rightWall);
-	world.addObject(&middle);
-	world.addObject(&left);
-	world.addObject(&right);
-
-	auto camera = Camera(800, 400, pi / 3);
-	camera.setTransform(viewTransform(Tuple::point(0, 1.5, -5), Tuple::point(0, 1, 0), Tuple::point(0, 1, 0)));
-
-	auto canvas = camera.render(world);
+	auto scene = Scene::worldWithPatterns();
+	auto camera = scene->camera(800, 400);
+
+	auto canvas = camera.render(scene->world);
 	canvas.savePPM("canvas.ppm");
 
-	ShellExecute(NULL, NULL, L"canvas.ppm", NULL, NULL, SW_SHOW);
+	showCanvas();
 }
 
 // 11
 void worldRefraction()
 {
-	auto floor = Plane();
-	auto fPattern = CheckersPattern(Color(.35), Color(.65));
-	fPattern.transform = rotationY(pi / 4);
-	floor.material = Material();
-	floor.material.reflective = 0.4;
-	floor.material.specular = 0;
-	floor.material.pattern = &fPattern;
-
-	auto redMaterial = Material();
-	redMaterial.color = Color(1, 0.3, 0.2);
-	redMaterial.specular = .4;
-	redMaterial.shininess = 5;
-
-	auto redSphere1 = Sphere();
-	redSphere1.transform = translation(6, 1, 4);
-	redSphere1.material = redMaterial;
-
-	auto redSphere2 = Sphere();
-	redSphere2.transform = translation(2, 1, 3);
-	redSphere2.material = redMaterial;
-
-	auto redSphere3 = Sphere();
-	redSphere3.transform = translation(-1, 1, 2);
-	redSphere3.material = redMaterial;
-
-	auto blueGlassSphere = Sphere();
-	blueGlassSphere.material.color = Color(0, 0, 0.2);
-	blueGlassSphere.material.ambient = 0;
-	blueGlassSphere.material.diffuse = 0.2;
-	blueGlassSphere.material.specular = 0.9;
-	blueGlassSphere.material.shininess = 300;
-	blueGlassSphere.material.reflective = 0.9;
-	blueGlassSphere.material.transparency = 0.9;
-	blueGlassSphere.material.refractiveIndex = 1.5;
-	blueGlassSphere.transform = scaling(0.7) * translation(0.6, 0.7, -0.6);
-
-	auto greenGlassSphere = Sphere();
-	greenGlassSphere.material.color = Color(0, 0.2, 0);
-	greenGlassSphere.material.ambient = 0;
-	greenGlassSphere.material.diffuse = 0.2;
-	greenGlassSphere.material.specular = 0.9;
-	greenGlassSphere.material.shininess = 300;
-	greenGlassSphere.material.reflective = 0.9;
-	greenGlassSphere.material.transparency = 0.9;
-	greenGlassSphere.material.refractiveIndex = 1.5;
-	greenGlassSphere.transform = scaling(0.5) * translation(-0.7, 0.5, -0.8);
-
-	auto world = World();
-	world.light = PointLight(Tuple::point(-4.9, 4.9, -1), Color(1));
-	world.addObject(&floor);
-	world.addObject(&redSphere1);
-	world.addObject(&redSphere2);
-	world.addObject(&redSphere3);
-	world.addObject(&blueGlassSphere);
-	world.addObject(&greenGlassSphere);
-
-	auto camera = Camera(1920, 1080, pi / 3);
-	//auto camera = Camera(800, 400, pi / 3);
-	camera.setTransform(viewTransform(Tuple::point(0, 1.5, -5), Tuple::point(0, 1, 0), Tuple::point(0, 1, 0)));
-
-	auto canvas = camera.render(world);
-	canvas.savePPM("canvas.ppm");
+	auto scene = Scene::worldRefraction();
+	auto camera = scene->camera(1920, 1080);
+	//auto camera = scene->camera(800, 400);
+	camera.setPixelCost(PixelCost::Rays);
+	camera.setThreads(0);
+
+	auto result = camera.renderWithStats(scene->world);
+	result.canvas.savePPM("canvas.ppm");
+	result.cost.heatmap().savePPM("canvas_cost.ppm");
+	std::cout << result.stats.toJson();
+
+	showCanvas();
+}
 
-	ShellExecute(NULL, NULL, L"canvas.ppm", NULL, NULL, SW_SHOW);
+// Renders a scene with worker processes:
+//   RaytracerChallenge --coordinator [--scene name] [--size WxH] [--tile n] [--samples n] [--port n] [--tile-timeout ms] [--output file]
+//   RaytracerChallenge --worker --port n [--host ip] [--threads n] [--max-tiles n]
+int distributed(int argc, char* argv[])
+{
+	TileJob job = { "worldRefraction", 1920, 1080, 32, 1 };
+	CoordinatorOptions coordinator;
+	WorkerOptions worker;
+	std::string output = "canvas.ppm";
+	bool isWorker = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--worker") == 0)
+			isWorker = true;
+		else if (strcmp(argv[i], "--coordinator") == 0)
+			isWorker = false;
+		else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+			job.scene = argv[++i];
+		else if (strcmp(argv[i], "--size") == 0 && hasValue)
+		{
+			const char* size = argv[++i];
+			job.width = atoi(size);
+			job.height = strchr(size, 'x') ? atoi(strchr(size, 'x') + 1) : job.width;
+		}
+		else if (strcmp(argv[i], "--tile") == 0 && hasValue)
+			job.tileSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--samples") == 0 && hasValue)
+			job.antialiasSamples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--port") == 0 && hasValue)
+			coordinator.port = worker.port = (unsigned short)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--tile-timeout") == 0 && hasValue)
+			coordinator.tileTimeout = std::chrono::milliseconds(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--output") == 0 && hasValue)
+			output = argv[++i];
+		else if (strcmp(argv[i], "--host") == 0 && hasValue)
+			worker.host = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+			worker.threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--max-tiles") == 0 && hasValue)
+			worker.maxTiles = atoi(argv[++i]);
+		else
+		{
+			std::cerr << "unknown argument " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (isWorker)
+	{
+		int tiles = runRenderWorker(worker);
+		if (tiles < 0)
+			return 1;
+		std::cout << "rendered " << tiles << " tiles" << std::endl;
+		return 0;
+	}
+
+	if (Scene::byName(job.scene) == nullptr || job.width == 0 || job.height == 0 || job.tileSize == 0)
+	{
+		std::cerr << "invalid job" << std::endl;
+		return 1;
+	}
+	coordinator.onListening = [&](unsigned short port) {
+		std::cout << "listening on port " << port << ", " << job.getTileCount() << " tiles" << std::endl;
+	};
+	auto canvas = coordinateRender(job, coordinator);
+	if (canvas.width == 0)
+		return 1;
+	canvas.savePPM(output);
+	return 0;
 }
 
-int main(char* ars[])
+int main(int argc, char* argv[])
 {
+	if (argc > 1)
+		return distributed(argc, argv);
+
 	//projectileLaucher();
 	//analogClock();
 	//silhouetteRayCaster();
@@ -426,4 +322,7 @@ int main(char* ars[])
 	//worldWithPatterns();
 	worldRefraction();
 
-}
+#ifdef RAYTRACER_TRACE
+	Trace::save("trace.json");
+#endif
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <deque>
+#include <memory>
+
 #include "color.h"
 
 class Tuple;
@@ -7,6 +10,13 @@ class Pattern;
 class Shape;
 class Light;
 
+// Lighting split into the part that is always present and the part a shadow can block.
+struct LightingTerms
+{
+	Color ambient;
+	Color direct;	// diffuse + specular
+};
+
 class Material
 {
 public:
@@ -25,9 +35,73 @@ public:
 	Material();
 
 	Color lighting(const Shape& object, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal, const bool inShadow) const;
+	LightingTerms lightingTerms(const Shape& object, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal) const;
+	LightingTerms lightingTerms(const Color& surfaceColor, const Light& light, const Tuple& pos, const Tuple& eye, const Tuple& normal) const;
+
+	// color of the surface at pos, either the plain color or the pattern
+	Color colorAt(const Shape& object, const Tuple& pos) const;
 
 	bool operator==(const Material& rhs) const;
 
 	friend std::wstring ToString(const Material& m);
 };
 
+class MaterialLibrary
+{
+private:
+	// a deque keeps references to the materials valid when more are added
+	std::deque<Material> materials;
+
+public:
+	// slot 0 always holds the default material
+	MaterialLibrary();
+
+	size_t add(const Material& m);
+	size_t count() const;
+
+	const Material& operator[](size_t index) const;
+	Material& operator[](size_t index);
+};
+
+// Compact handle to a material stored in a MaterialLibrary. Handles copied from each other share the material,
+// writing through one of them copies it into a slot of its own first, so an edit never reaches another shape. Edit
+// the library to change a shared material in place. A fresh handle owns its material until the shape is added to a
+// world, which moves it into its library.
+class MaterialRef
+{
+private:
+	MaterialLibrary* library;	// null while the material is owned
+	unsigned int index;
+	std::unique_ptr<Material> owned;
+	mutable bool shared;	// other handles may point at the slot
+
+public:
+	MaterialRef();
+	MaterialRef(MaterialLibrary& library, size_t index);
+	// shares the material of a library, copies an owned one
+	MaterialRef(const MaterialRef& other);
+	MaterialRef(MaterialRef&& other) noexcept;
+	MaterialRef& operator=(const MaterialRef& other);
+	MaterialRef& operator=(MaterialRef&& other) noexcept;
+
+	// gives the handle a slot of its own holding m, other handles keep their material
+	MaterialRef& operator=(const Material& m);
+
+	// Points the handle at a copy of its material in library, unless it is already stored there.
+	void moveTo(MaterialLibrary& library);
+
+	size_t getIndex() const;
+	const MaterialLibrary* getLibrary() const;
+
+	const Material& get() const;
+	// the material of this handle alone, copied into a new slot if it may be shared
+	Material& get();
+
+	const Material* operator->() const;
+	Material* operator->();
+	const Material& operator*() const;
+	Material& operator*();
+	operator const Material&() const;
+
+	bool operator==(const MaterialRef& rhs) const;
+};
@@ -339,3 +339,40 @@ std::wstring ToString(const Matrix<4, 4>& m)
     ss << "| " << m._41 << " " << m._42 << " " << m._43 << " " << m._44 << " |" << std::endl;
     return ss.str();
 }
+
+Transform::Transform(const Matrix<4, 4>& m)
+    : matrix(m), inverseMatrix(inverse(m))
+{
+}
+
+Transform& Transform::operator=(const Matrix<4, 4>& m)
+{
+    matrix = m;
+    inverseMatrix = inverse(m);
+    return *this;
+}
+
+const Matrix<4, 4>& Transform::getMatrix() const
+{
+    return matrix;
+}
+
+const Matrix<4, 4>& Transform::getInverse() const
+{
+    return inverseMatrix;
+}
+
+Transform::operator const Matrix<4, 4>&() const
+{
+    return matrix;
+}
+
+bool operator==(const Transform& lhs, const Transform& rhs)
+{
+    return lhs.matrix == rhs.matrix;
+}
+
+Tuple operator*(const Transform& t, const Tuple& v)
+{
+    return t.matrix * v;
+}
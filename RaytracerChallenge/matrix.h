@@ -106,4 +106,25 @@ public:
 	friend std::wstring ToString(const Matrix& m);
 };
 
+// A transform with its inverse, computed once when the transform is assigned instead of every time it is used.
+// The elements can only be read, assign a whole matrix to change it so the inverse follows.
+class Transform
+{
+private:
+	Matrix<4, 4> matrix;
+	Matrix<4, 4> inverseMatrix;
+
+public:
+	explicit Transform(const Matrix<4, 4>& m);
+
+	Transform& operator=(const Matrix<4, 4>& m);
+
+	const Matrix<4, 4>& getMatrix() const;
+	const Matrix<4, 4>& getInverse() const;
+	operator const Matrix<4, 4>&() const;
+
+	friend bool operator==(const Transform& lhs, const Transform& rhs);
+	friend Tuple operator*(const Transform& t, const Tuple& v);
+};
+
 
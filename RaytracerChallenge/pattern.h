@@ -18,7 +18,7 @@ class Shape;
 class Pattern
 {
 public:
-	Matrix<4, 4> transform;
+	Transform transform;
 
 	Pattern();
 
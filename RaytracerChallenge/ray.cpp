@@ -1,7 +1,17 @@
 #include "ray.h"
 
+Ray::Ray()
+	: origin(Tuple::point(0, 0, 0)), direction(Tuple::vector(0, 0, 0)), source(nullptr), intoSource(false)
+{
+}
+
 Ray::Ray(const Tuple& origin, const Tuple& direction)
-	: origin(origin), direction(direction)
+	: origin(origin), direction(direction), source(nullptr), intoSource(false)
+{
+}
+
+Ray::Ray(const Tuple& origin, const Tuple& direction, const Shape* source, bool intoSource)
+	: origin(origin), direction(direction), source(source), intoSource(intoSource)
 {
 }
 
@@ -19,5 +29,7 @@ Ray& Ray::operator=(const Ray& other)
 {
 	origin = other.origin;
 	direction = other.direction;
+	source = other.source;
+	intoSource = other.intoSource;
 	return *this;
 }
@@ -3,16 +3,22 @@
 #include "matrix.h"
 #include "tuple.h"
 
+class Shape;
 
 class Ray
 {
 public:
 	Tuple origin;
 	Tuple direction;
+	// The primitive the ray leaves from, if any, and whether it heads into it. Traversal uses this on top of
+	// the offset origin to avoid hitting that primitive again.
+	const Shape* source;
+	bool intoSource;
 
 public:
 	Ray();
 	Ray(const Tuple& origin, const Tuple& direction);
+	Ray(const Tuple& origin, const Tuple& direction, const Shape* source, bool intoSource);
 
 	Tuple pos(float t) const;
 	Ray transform(const Matrix<4, 4>& transform) const;
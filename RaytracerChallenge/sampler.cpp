@@ -0,0 +1,216 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+thread_local PixelSample currentSample = { 0, 0, 0 };
+
+static unsigned int mix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+// x in [0, 2) back into [0, 1)
+static float wrap(float x)
+{
+	return x >= 1.f ? x - 1.f : x;
+}
+
+static unsigned int gridSize(unsigned int count)
+{
+	unsigned int n = (unsigned int)sqrtf((float)count);
+	while (n * n < count)
+		n++;
+	return n;
+}
+
+static unsigned int reverseBits(unsigned int v)
+{
+	v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+	v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+	v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+	v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+const Sampler& Sampler::regular()
+{
+	static const RegularSampler sampler;
+	return sampler;
+}
+
+const PixelSample& Sampler::current()
+{
+	return currentSample;
+}
+
+void Sampler::setCurrent(const PixelSample& pixel)
+{
+	currentSample = pixel;
+}
+
+unsigned int Sampler::hash(const PixelSample& pixel, unsigned int dimension)
+{
+	return mix(pixel.x + mix(pixel.y + mix(pixel.index + mix(dimension))));
+}
+
+float Sampler::toFloat(unsigned int bits)
+{
+	return (bits >> 8) * (1.f / 16777216.f);
+}
+
+Sample2D RegularSampler::get(const PixelSample&, unsigned int, unsigned int index, unsigned int count) const
+{
+	unsigned int n = gridSize(count);
+	return { (index % n + 0.5f) / n, (index / n + 0.5f) / n };
+}
+
+Sample2D StratifiedSampler::get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const
+{
+	unsigned int n = gridSize(count);
+	unsigned int h = mix(hash(pixel, dimension) ^ (index * 0x9e3779b9u));
+	return { (index % n + toFloat(h)) / n, (index / n + toFloat(mix(h))) / n };
+}
+
+Sample2D HaltonSampler::get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int) const
+{
+	float u = toFloat(reverseBits(index));
+
+	float v = 0.f;
+	float digit = 1.f / 3.f;
+	for (unsigned int i = index; i > 0; i /= 3, digit /= 3.f)
+		v += (i % 3) * digit;
+
+	unsigned int h = hash(pixel, dimension);
+	return { wrap(u + toFloat(h)), wrap(v + toFloat(mix(h))) };
+}
+
+Sample2D SobolSampler::get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int) const
+{
+	unsigned int h = hash(pixel, dimension);
+
+	// second dimension, its generator matrix is the Pascal triangle mod 2
+	unsigned int v = mix(h);
+	for (unsigned int i = index, column = 1u << 31; i > 0; i >>= 1, column ^= column >> 1)
+	{
+		if (i & 1)
+			v ^= column;
+	}
+
+	return { toFloat(reverseBits(index) ^ h), toFloat(v) };
+}
+
+// Void and cluster: a few random pixels are spread out by moving the pixel in the tightest cluster into the largest
+// void until that stops changing anything. Then, starting from that pattern, pixels are ranked by removing the
+// tightest clusters one after the other, and by filling the largest voids until the mask is full. Clusters and voids
+// are found with a gaussian energy over the distance to the set pixels, wrapping around the edges so the mask tiles.
+BlueNoiseSampler::BlueNoiseSampler()
+	: mask(size * size)
+{
+	const unsigned int n = size * size;
+	const unsigned int wrapMask = size - 1;
+
+	std::vector<float> kernel(n);
+	const float sigma = 1.5f;
+	for (unsigned int y = 0; y < size; y++)
+		for (unsigned int x = 0; x < size; x++)
+		{
+			float dx = (float)std::min(x, size - x);
+			float dy = (float)std::min(y, size - y);
+			kernel[y * size + x] = expf(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+		}
+
+	std::vector<char> set(n, 0);
+	std::vector<float> energy(n, 0.f);
+	auto toggle = [&](unsigned int p) {
+		set[p] = !set[p];
+		float sign = set[p] ? 1.f : -1.f;
+		unsigned int px = p % size;
+		unsigned int py = p / size;
+		for (unsigned int y = 0; y < size; y++)
+			for (unsigned int x = 0; x < size; x++)
+				energy[y * size + x] += sign * kernel[((y - py) & wrapMask) * size + ((x - px) & wrapMask)];
+	};
+	auto tightestCluster = [&]() {
+		unsigned int best = 0;
+		for (unsigned int p = 0; p < n; p++)
+			if (set[p] && (!set[best] || energy[p] > energy[best]))
+				best = p;
+		return best;
+	};
+	auto largestVoid = [&]() {
+		unsigned int best = 0;
+		for (unsigned int p = 0; p < n; p++)
+			if (!set[p] && (set[best] || energy[p] < energy[best]))
+				best = p;
+		return best;
+	};
+
+	const unsigned int initial = n / 10;
+	unsigned int state = 1234;
+	for (unsigned int placed = 0; placed < initial;)
+	{
+		state = mix(state + 1);
+		if (!set[state % n])
+		{
+			toggle(state % n);
+			placed++;
+		}
+	}
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		auto cluster = tightestCluster();
+		toggle(cluster);
+		auto hole = largestVoid();
+		toggle(hole);
+		if (hole == cluster)
+			break;
+	}
+
+	std::vector<unsigned int> rank(n);
+	auto prototype = set;
+	auto prototypeEnergy = energy;
+	for (unsigned int r = initial; r > 0; r--)
+	{
+		auto cluster = tightestCluster();
+		toggle(cluster);
+		rank[cluster] = r - 1;
+	}
+
+	set = prototype;
+	energy = prototypeEnergy;
+	for (unsigned int r = initial; r < n; r++)
+	{
+		auto hole = largestVoid();
+		toggle(hole);
+		rank[hole] = r;
+	}
+
+	for (unsigned int p = 0; p < n; p++)
+		mask[p] = (rank[p] + 0.5f) / n;
+}
+
+Sample2D BlueNoiseSampler::get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int) const
+{
+	// R2 steps by the inverse powers of the plastic number
+	double u = 0.5 + index * 0.7548776662466927;
+	double v = 0.5 + index * 0.5698402909980532;
+
+	// the shift depends on the pixel only through the mask, every dimension reads it at its own offsets
+	unsigned int h = hash({ 0, 0, pixel.index }, dimension);
+	float su = maskAt(pixel.x + (h & 0xff), pixel.y + ((h >> 8) & 0xff));
+	float sv = maskAt(pixel.x + ((h >> 16) & 0xff), pixel.y + (h >> 24));
+
+	return { wrap((float)(u - floor(u)) + su), wrap((float)(v - floor(v)) + sv) };
+}
+
+float BlueNoiseSampler::maskAt(unsigned int x, unsigned int y) const
+{
+	return mask[(y % size) * size + x % size];
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+// A point in [0, 1)^2
+struct Sample2D
+{
+	float u;
+	float v;
+};
+
+// The camera sample being traced, set by the camera on the thread tracing it. Lighting seeds its samples with it.
+struct PixelSample
+{
+	unsigned int x;
+	unsigned int y;
+	unsigned int index;	// of the samples of the pixel
+};
+
+// Generates the points used to sample a pixel, an area light, ... Points are a pure function of the pixel sample,
+// the dimension (what is being sampled) and the index of the point, so a render is reproducible no matter which
+// thread traces which pixel.
+class Sampler
+{
+public:
+	enum Dimension
+	{
+		Pixel = 0,	// position in the pixel
+		Light = 1	// position on an area light, plus a hash of the light
+	};
+
+	virtual ~Sampler() = default;
+
+	// The index-th of count points for the pixel sample and dimension.
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const = 0;
+
+	// Centers of a grid, what is used when no sampler is set.
+	static const Sampler& regular();
+
+	static const PixelSample& current();
+	static void setCurrent(const PixelSample& pixel);
+
+protected:
+	static unsigned int hash(const PixelSample& pixel, unsigned int dimension);
+	// uniform in [0, 1)
+	static float toFloat(unsigned int bits);
+};
+
+// Centers of the cells of the smallest square grid with at least count cells.
+class RegularSampler : public Sampler
+{
+public:
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const override;
+};
+
+// A random point in every cell of the grid.
+class StratifiedSampler : public Sampler
+{
+public:
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const override;
+};
+
+// Halton sequence in bases 2 and 3, shifted by a random offset per pixel sample and dimension.
+class HaltonSampler : public Sampler
+{
+public:
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const override;
+};
+
+// The first two Sobol dimensions, a (0, 2)-sequence: every power of two points from the start are stratified in
+// every grid of that many cells. Each pixel sample and dimension uses its own random digital shift, which keeps that.
+class SobolSampler : public Sampler
+{
+public:
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const override;
+};
+
+// R2 sequence, shifted by a blue noise mask over the pixels. Every pixel's points are well spread, and the error
+// of neighboring pixels is decorrelated, which looks like fine grain instead of blotches at low sample counts.
+class BlueNoiseSampler : public Sampler
+{
+private:
+	static const unsigned int size = 64;
+	std::vector<float> mask;	// size x size, a value in [0, 1) per pixel
+
+public:
+	BlueNoiseSampler();
+
+	virtual Sample2D get(const PixelSample& pixel, unsigned int dimension, unsigned int index, unsigned int count) const override;
+
+	float maskAt(unsigned int x, unsigned int y) const;
+};
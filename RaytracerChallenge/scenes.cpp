@@ -0,0 +1,290 @@
+#include "scenes.h"
+
+#include <cstdlib>
+
+#include "trace.h"
+
+Scene::Scene()
+	: view(viewTransform(Tuple::point(0, 1.5f, -5), Tuple::point(0, 1, 0), Tuple::point(0, 1, 0))), fov(pi / 3)
+{
+}
+
+Camera Scene::camera(unsigned int width, unsigned int height) const
+{
+	auto camera = Camera(width, height, fov);
+	camera.setTransform(view);
+	return camera;
+}
+
+std::unique_ptr<Scene> Scene::simpleWorld()
+{
+	TRACE_SCOPE("prepare scene");
+	auto scene = std::make_unique<Scene>();
+	auto& world = scene->world;
+
+	auto wallMaterial = world.addMaterial(Material());
+	wallMaterial->color = Color(1, 0.9f, 0.9f);
+	wallMaterial->specular = 0;
+
+	auto& floor = scene->add<Sphere>();
+	floor.transform = scaling(10, 0.01f, 10);
+	floor.material = wallMaterial;
+
+	auto& leftWall = scene->add<Sphere>();
+	leftWall.transform = translation(0, 0, 5) * rotationY(-pi / 4) * rotationX(pi / 2) * scaling(10, 0.1f, 10);
+	leftWall.material = wallMaterial;
+
+	auto& rightWall = scene->add<Sphere>();
+	rightWall.transform = translation(0, 0, 5) * rotationY(pi / 4) * rotationX(pi / 2) * scaling(10, 0.1f, 10);
+	rightWall.material = wallMaterial;
+
+	auto& middle = scene->add<Sphere>();
+	middle.transform = translation(-0.5f, 1, 0.5f) * scaling(0.6f, 0.4f, 2.0f);
+	middle.material = world.addMaterial(Material());
+	middle.material->color = Color(0.1f, 1, 0.5f);
+	middle.material->diffuse = 0.7f;
+	middle.material->specular = 0.3f;
+
+	auto& left = scene->add<Sphere>();
+	left.transform = translation(-1.5f, 0.33f, -0.75f) * scaling(0.33f, 0.33f, 0.33f);
+	left.material = world.addMaterial(Material());
+	left.material->color = Color(1, 0.8f, 0.1f);
+	left.material->diffuse = 0.7f;
+	left.material->specular = 0.3f;
+
+	auto& right = scene->add<Sphere>();
+	right.transform = translation(1.5f, 0.5f, -0.5f) * scaling(0.5f, 0.5f, 0.5f);
+	right.material = world.addMaterial(Material());
+	right.material->color = Color(0.5f, 1, 0.1f);
+	right.material->diffuse = 0.7f;
+	right.material->specular = 0.3f;
+
+	world.lights.push_back(PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1)));
+	return scene;
+}
+
+std::unique_ptr<Scene> Scene::worldWithPlanes()
+{
+	TRACE_SCOPE("prepare scene");
+	auto scene = std::make_unique<Scene>();
+	auto& world = scene->world;
+
+	auto wallMaterial = world.addMaterial(Material());
+	wallMaterial->color = Color(1, 0.9f, 0.9f);
+	wallMaterial->specular = 0;
+
+	auto& floor = scene->add<Plane>();
+	floor.material = wallMaterial;
+
+	auto& leftWall = scene->add<Plane>();
+	leftWall.transform = translation(0, 0, 5) * rotationY(-pi / 4) * rotationX(pi / 2);
+	leftWall.material = wallMaterial;
+
+	auto& rightWall = scene->add<Plane>();
+	rightWall.transform = translation(0, 0, 5) * rotationY(pi / 4) * rotationX(pi / 2);
+	rightWall.material = wallMaterial;
+
+	auto& middle = scene->add<Sphere>();
+	middle.transform = translation(-0.5f, 1, 0.5f) * scaling(0.6f, 0.4f, 2.0f);
+	middle.material = world.addMaterial(Material());
+	middle.material->color = Color(0.1f, 1, 0.5f);
+	middle.material->diffuse = 0.7f;
+	middle.material->specular = 0.3f;
+
+	auto& left = scene->add<Sphere>();
+	left.transform = translation(-1.5f, 0.33f, -0.75f) * scaling(0.33f, 0.33f, 0.33f);
+	left.material = world.addMaterial(Material());
+	left.material->color = Color(1, 0.8f, 0.1f);
+	left.material->diffuse = 0.7f;
+	left.material->specular = 0.3f;
+
+	auto& right = scene->add<Sphere>();
+	right.transform = translation(1.5f, 0.5f, -0.5f) * scaling(0.5f, 0.5f, 0.5f);
+	right.material = world.addMaterial(Material());
+	right.material->color = Color(0.5f, 1, 0.1f);
+	right.material->diffuse = 0.7f;
+	right.material->specular = 0.3f;
+
+	world.lights.push_back(PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1)));
+	return scene;
+}
+
+std::unique_ptr<Scene> Scene::worldWithPatterns()
+{
+	TRACE_SCOPE("prepare scene");
+	auto scene = std::make_unique<Scene>();
+	auto& world = scene->world;
+
+	auto& floorPattern = scene->addPattern(CheckersPattern(Color(1, 1, 1), Color(0, 0, 0)));
+	floorPattern.transform = translation(0, -0.1f, 0) * rotationY(pi / 4) * scaling(2, 2, 2);
+	auto& leftWallPattern = scene->addPattern(RingPattern(Color(1, 1, 1), Color(1, 0, 0)));
+	auto& stripes = scene->addPattern(StripePattern(Color(1, 0.5f, 0), Color(1, 0.3f, 0)));
+	stripes.transform = rotationZ(pi / 2) * scaling(0.05f, 0.05f, 0.05f);
+
+	auto& floor = scene->add<Plane>();
+	floor.material = world.addMaterial(Material());
+	floor.material->specular = 0;
+	floor.material->pattern = &floorPattern;
+
+	auto& leftWall = scene->add<Plane>();
+	leftWall.transform = translation(0, 0, 4.9f) * rotationY(-pi / 4) * rotationX(pi / 2);
+	leftWall.material = world.addMaterial(*floor.material);
+	leftWall.material->pattern = &leftWallPattern;
+
+	auto& rightWall = scene->add<Plane>();
+	rightWall.transform = translation(0, 0, 4.9f) * rotationY(pi / 4) * rotationX(pi / 2);
+	rightWall.material = world.addMaterial(*floor.material);
+	rightWall.material->ambient = 0.f;
+	rightWall.material->diffuse = 0.f;
+	rightWall.material->reflective = 0.8f;
+	rightWall.material->pattern = nullptr;
+
+	auto& middle = scene->add<Sphere>();
+	middle.transform = translation(-0.5f, 1, 0.5f) * scaling(0.6f, 0.4f, 2.0f);
+	middle.material = world.addMaterial(Material());
+	middle.material->color = Color(0.1f, 1, 0.5f);
+	middle.material->diffuse = 0.7f;
+	middle.material->specular = 0.3f;
+	middle.material->pattern = &stripes;
+
+	auto& left = scene->add<Sphere>();
+	left.transform = translation(-1.5f, 0.33f, -0.75f) * scaling(0.33f, 0.33f, 0.33f);
+	left.material = world.addMaterial(Material());
+	left.material->color = Color(1, 0.8f, 0.1f);
+	left.material->diffuse = 0.7f;
+	left.material->specular = 0.3f;
+
+	auto& right = scene->add<Sphere>();
+	right.transform = translation(1.5f, 0.5f, -0.5f) * scaling(0.5f, 0.5f, 0.5f);
+	right.material = world.addMaterial(Material());
+	right.material->color = Color(0.5f, 1, 0.1f);
+	right.material->diffuse = 0.7f;
+	right.material->specular = 0.3f;
+
+	world.lights.push_back(PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1)));
+	return scene;
+}
+
+std::unique_ptr<Scene> Scene::worldRefraction()
+{
+	TRACE_SCOPE("prepare scene");
+	auto scene = std::make_unique<Scene>();
+	auto& world = scene->world;
+
+	auto& floorPattern = scene->addPattern(CheckersPattern(Color(.35f), Color(.65f)));
+	floorPattern.transform = rotationY(pi / 4);
+
+	auto& floor = scene->add<Plane>();
+	floor.material = world.addMaterial(Material());
+	floor.material->reflective = 0.4f;
+	floor.material->specular = 0;
+	floor.material->pattern = &floorPattern;
+
+	// shared by all red spheres
+	auto redMaterial = world.addMaterial(Material());
+	redMaterial->color = Color(1, 0.3f, 0.2f);
+	redMaterial->specular = .4f;
+	redMaterial->shininess = 5;
+
+	auto& redSphere1 = scene->add<Sphere>();
+	redSphere1.transform = translation(6, 1, 4);
+	redSphere1.material = redMaterial;
+
+	auto& redSphere2 = scene->add<Sphere>();
+	redSphere2.transform = translation(2, 1, 3);
+	redSphere2.material = redMaterial;
+
+	auto& redSphere3 = scene->add<Sphere>();
+	redSphere3.transform = translation(-1, 1, 2);
+	redSphere3.material = redMaterial;
+
+	auto glass = Material();
+	glass.ambient = 0;
+	glass.diffuse = 0.2f;
+	glass.specular = 0.9f;
+	glass.shininess = 300;
+	glass.reflective = 0.9f;
+	glass.transparency = 0.9f;
+	glass.refractiveIndex = 1.5f;
+
+	auto& blueGlassSphere = scene->add<Sphere>();
+	blueGlassSphere.material = world.addMaterial(glass);
+	blueGlassSphere.material->color = Color(0, 0, 0.2f);
+	blueGlassSphere.transform = scaling(0.7f) * translation(0.6f, 0.7f, -0.6f);
+
+	auto& greenGlassSphere = scene->add<Sphere>();
+	greenGlassSphere.material = world.addMaterial(glass);
+	greenGlassSphere.material->color = Color(0, 0.2f, 0);
+	greenGlassSphere.transform = scaling(0.5f) * translation(-0.7f, 0.5f, -0.8f);
+
+	world.lights.push_back(PointLight(Tuple::point(-4.9f, 4.9f, -1), Color(1)));
+	return scene;
+}
+
+std::unique_ptr<Scene> Scene::sphereGrid(unsigned int n)
+{
+	TRACE_SCOPE("prepare scene");
+	auto scene = std::make_unique<Scene>();
+	auto& world = scene->world;
+
+	auto& floorPattern = scene->addPattern(CheckersPattern(Color(.35f), Color(.65f)));
+
+	auto& floor = scene->add<Plane>();
+	floor.material = world.addMaterial(Material());
+	floor.material->reflective = 0.3f;
+	floor.material->specular = 0;
+	floor.material->pattern = &floorPattern;
+
+	auto matte = world.addMaterial(Material());
+	matte->color = Color(1, 0.3f, 0.2f);
+	matte->specular = 0.4f;
+
+	auto mirror = world.addMaterial(Material());
+	mirror->color = Color(0.1f, 0.1f, 0.1f);
+	mirror->diffuse = 0.1f;
+	mirror->reflective = 0.9f;
+
+	auto glass = world.addMaterial(Material());
+	glass->color = Color(0, 0, 0.1f);
+	glass->ambient = 0;
+	glass->diffuse = 0.1f;
+	glass->shininess = 300;
+	glass->reflective = 0.9f;
+	glass->transparency = 0.9f;
+	glass->refractiveIndex = 1.5f;
+
+	const MaterialRef materials[] = { matte, mirror, glass };
+	float offset = (n - 1) / 2.f;
+	for (unsigned int z = 0; z < n; z++)
+		for (unsigned int x = 0; x < n; x++)
+		{
+			auto& sphere = scene->add<Sphere>();
+			sphere.transform = translation(x - offset, 0.4f, z - offset) * scaling(0.4f);
+			sphere.material = materials[(x + z) % 3];
+		}
+
+	world.lights.push_back(PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1)));
+	scene->view = viewTransform(Tuple::point(0, 1.5f + 0.6f * n, -3 - 0.9f * n), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0));
+	return scene;
+}
+
+std::unique_ptr<Scene> Scene::byName(const std::string& name)
+{
+	if (name == "simpleWorld")
+		return simpleWorld();
+	if (name == "worldWithPlanes")
+		return worldWithPlanes();
+	if (name == "worldWithPatterns")
+		return worldWithPatterns();
+	if (name == "worldRefraction")
+		return worldRefraction();
+
+	const std::string grid = "sphereGrid";
+	if (name.compare(0, grid.size(), grid) == 0)
+	{
+		int n = atoi(name.c_str() + grid.size());
+		if (n > 0)
+			return sphereGrid(n);
+	}
+	return nullptr;
+}
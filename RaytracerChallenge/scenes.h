@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "world.h"
+#include "camera.h"
+#include "shape.h"
+#include "pattern.h"
+
+// A world together with the shapes and patterns it points to and the view of its camera. The scenes of the
+// chapters live here so the executable and the benchmarks render the same thing.
+class Scene
+{
+public:
+	World world;
+	std::vector<std::unique_ptr<Shape>> shapes;
+	std::vector<std::unique_ptr<Pattern>> patterns;
+	Matrix<4, 4> view;
+	float fov;
+
+public:
+	Scene();
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	// Creates a shape owned by the scene and adds it to the world.
+	template<typename T>
+	T& add();
+	template<typename T>
+	T& addPattern(const T& pattern);
+
+	Camera camera(unsigned int width, unsigned int height) const;
+
+	// chapter 7
+	static std::unique_ptr<Scene> simpleWorld();
+	// chapter 9
+	static std::unique_ptr<Scene> worldWithPlanes();
+	// chapter 10
+	static std::unique_ptr<Scene> worldWithPatterns();
+	// chapter 11
+	static std::unique_ptr<Scene> worldRefraction();
+	// n x n spheres over a reflective floor, cycling through matte, mirror and glass materials
+	static std::unique_ptr<Scene> sphereGrid(unsigned int n);
+
+	// One of the above by the name of its factory, "sphereGrid4" for sphereGrid(4). Null for an unknown name.
+	static std::unique_ptr<Scene> byName(const std::string& name);
+};
+
+template<typename T>
+T& Scene::add()
+{
+	auto shape = std::make_unique<T>();
+	auto& ref = *shape;
+	world.addObject(shape.get());
+	shapes.push_back(std::move(shape));
+	return ref;
+}
+
+template<typename T>
+T& Scene::addPattern(const T& pattern)
+{
+	auto copy = std::make_unique<T>(pattern);
+	auto& ref = *copy;
+	patterns.push_back(std::move(copy));
+	return ref;
+}
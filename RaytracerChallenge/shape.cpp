@@ -1,5 +1,7 @@
 #include "shape.h"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <iomanip>
 
@@ -7,6 +9,74 @@
 #include "math.h"
 #include "ray.h"
 
+Bounds::Bounds()
+    : min(Tuple::point(INFINITY, INFINITY, INFINITY)), max(Tuple::point(-INFINITY, -INFINITY, -INFINITY))
+{
+}
+
+Bounds::Bounds(const Tuple& min, const Tuple& max)
+    : min(min), max(max)
+{
+}
+
+Bounds Bounds::everything()
+{
+    return Bounds(Tuple::point(-INFINITY, -INFINITY, -INFINITY), Tuple::point(INFINITY, INFINITY, INFINITY));
+}
+
+bool Bounds::isEmpty() const
+{
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+void Bounds::add(const Tuple& point)
+{
+    min.x = std::min(min.x, point.x);
+    min.y = std::min(min.y, point.y);
+    min.z = std::min(min.z, point.z);
+    max.x = std::max(max.x, point.x);
+    max.y = std::max(max.y, point.y);
+    max.z = std::max(max.z, point.z);
+}
+
+void Bounds::add(const Bounds& other)
+{
+    add(other.min);
+    add(other.max);
+}
+
+float Bounds::growth(const Bounds& other) const
+{
+    auto merged = *this;
+    merged.add(other);
+    return (merged.max.x - merged.min.x) + (merged.max.y - merged.min.y) + (merged.max.z - merged.min.z)
+        - (max.x - min.x) - (max.y - min.y) - (max.z - min.z);
+}
+
+bool Bounds::overlaps(const Bounds& other) const
+{
+    return !isEmpty() && !other.isEmpty() && min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y
+        && min.z <= other.max.z && other.min.z <= max.z;
+}
+
+Bounds Bounds::transform(const Matrix<4, 4>& m) const
+{
+    if (isEmpty())
+        return *this;
+    if (std::isinf(min.x) || std::isinf(min.y) || std::isinf(min.z) || std::isinf(max.x) || std::isinf(max.y) || std::isinf(max.z))
+        return everything();
+
+    Bounds result;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        auto x = corner & 1 ? max.x : min.x;
+        auto y = corner & 2 ? max.y : min.y;
+        auto z = corner & 4 ? max.z : min.z;
+        result.add(m * Tuple::point(x, y, z));
+    }
+    return result;
+}
+
 Shape::Shape()
     : transform(Matrix<4, 4>::identity()), material()
 {
@@ -20,20 +90,25 @@ Sphere::Sphere()
 Sphere Sphere::glass()
 {
     Sphere s;
-    s.material.transparency = 1.f;
-    s.material.refractiveIndex = 1.5f;
+    s.material->transparency = 1.f;
+    s.material->refractiveIndex = 1.5f;
     return s;
 }
 
 Intersections Shape::intersect(const Ray& ray) const
 {
-    auto r = ray.transform(inverse(transform));
+    return intersect(ray, transform.getInverse());
+}
+
+Intersections Shape::intersect(const Ray& ray, const Matrix<4, 4>& inverseTransform) const
+{
+    auto r = ray.transform(inverseTransform);
     return intersectIntenal(r);
 }
 
 Tuple Shape::normal(const Tuple& point) const
 {
-    auto invTransform = inverse(transform);
+    const auto& invTransform = transform.getInverse();
     auto localPoint = invTransform * point;
     auto localNormal = normalInternal(localPoint);
     auto worldNormal = transpose(invTransform) * localNormal;
@@ -42,6 +117,31 @@ Tuple Shape::normal(const Tuple& point) const
     return normalize(worldNormal);
 }
 
+Bounds Shape::bounds() const
+{
+    return boundsInternal().transform(transform);
+}
+
+Bounds Shape::boundsInternal() const
+{
+    return Bounds::everything();
+}
+
+bool Shape::isConvex() const
+{
+    return false;
+}
+
+bool Shape::isClosed() const
+{
+    return false;
+}
+
+const char* Shape::typeName() const
+{
+    return "Shape";
+}
+
 std::wstring ToString(const Shape* p)
 {
     std::wstringstream ss;
@@ -72,6 +172,21 @@ bool Sphere::operator==(const Shape& rhs) const
     return center == s.center && areEqual(radius, s.radius);
 }
 
+bool Sphere::isConvex() const
+{
+    return true;
+}
+
+bool Sphere::isClosed() const
+{
+    return true;
+}
+
+const char* Sphere::typeName() const
+{
+    return "Sphere";
+}
+
 std::wstring Sphere::toString() const
 {
     return ToString(*this);
@@ -114,13 +229,29 @@ Tuple Sphere::normalInternal(const Tuple& point) const
     return point - center;
 }
 
+Bounds Sphere::boundsInternal() const
+{
+    auto extent = Tuple::vector(radius, radius, radius);
+    return Bounds(center - extent, center + extent);
+}
+
 Plane::Plane()
 {
 }
 
 bool Plane::operator==(const Shape& rhs) const
 {
-    return transform == rhs.transform && material == rhs.material;
+    return transform == rhs.transform && *material == *rhs.material;
+}
+
+bool Plane::isConvex() const
+{
+    return true;
+}
+
+const char* Plane::typeName() const
+{
+    return "Plane";
 }
 
 std::wstring Plane::toString() const
@@ -144,3 +275,8 @@ Tuple Plane::normalInternal(const Tuple& point) const
 {
     return Tuple::vector(0, 1, 0);
 }
+
+Bounds Plane::boundsInternal() const
+{
+    return Bounds(Tuple::point(-INFINITY, 0, -INFINITY), Tuple::point(INFINITY, 0, INFINITY));
+}
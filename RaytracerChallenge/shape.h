@@ -8,21 +8,53 @@
 class Ray;
 class Intersections;
 
+// An axis aligned box, its sides can be infinite. Empty until a point is added.
+struct Bounds
+{
+	Tuple min;
+	Tuple max;
+
+	Bounds();
+	Bounds(const Tuple& min, const Tuple& max);
+	static Bounds everything();
+
+	bool isEmpty() const;
+	void add(const Tuple& point);
+	void add(const Bounds& other);
+	// how much the sum of the side lengths grows when other is added
+	float growth(const Bounds& other) const;
+	bool overlaps(const Bounds& other) const;
+	// The box around this one transformed by m, everything if a side is infinite.
+	Bounds transform(const Matrix<4, 4>& m) const;
+};
+
 class Shape
 {
 public:
-	Matrix<4, 4> transform;
-	Material material;
+	Transform transform;
+	MaterialRef material;
 
 public:
 	Shape();
 	Shape(const Shape& other) = default;
 
 	virtual Intersections intersect(const Ray& r) const final;
+	// same as above with the inverse of transform given by the caller
+	Intersections intersect(const Ray& r, const Matrix<4, 4>& inverseTransform) const;
 	virtual Tuple normal(const Tuple& point) const final;
+	// a box around the shape in world space
+	Bounds bounds() const;
 
 	virtual bool operator==(const Shape& rhs) const = 0;
 
+	// A ray leaving a convex shape can't hit it again. If the shape is also closed, a ray going into it
+	// hits it exactly once more, on the far side.
+	virtual bool isConvex() const;
+	virtual bool isClosed() const;
+
+	// name the shape is counted under in render stats
+	virtual const char* typeName() const;
+
 	virtual std::wstring toString() const = 0;
 
 	friend std::wstring ToString(const Shape& p);
@@ -31,6 +63,8 @@ public:
 private:
 	virtual Intersections intersectIntenal(const Ray& r) const = 0;
 	virtual Tuple normalInternal(const Tuple& point) const = 0;
+	// in object space, everything unless the shape knows better
+	virtual Bounds boundsInternal() const;
 };
 
 class Sphere : public Shape
@@ -47,6 +81,10 @@ public:
 
 	virtual bool operator==(const Shape& rhs) const override;
 
+	virtual bool isConvex() const override;
+	virtual bool isClosed() const override;
+	virtual const char* typeName() const override;
+
 	virtual std::wstring toString() const;
 
 	Sphere& operator=(const Sphere& other);
@@ -56,6 +94,7 @@ public:
 private:
 	virtual Intersections intersectIntenal(const Ray& r) const override;
 	virtual Tuple normalInternal(const Tuple& point) const override;
+	virtual Bounds boundsInternal() const override;
 };
 
 class Plane : public Shape
@@ -68,10 +107,14 @@ public:
 
 	virtual bool operator==(const Shape& rhs) const override;
 
+	virtual bool isConvex() const override;
+	virtual const char* typeName() const override;
+
 	virtual std::wstring toString() const;
 
 
 private:
 	virtual Intersections intersectIntenal(const Ray& r) const override;
 	virtual Tuple normalInternal(const Tuple& point) const override;
+	virtual Bounds boundsInternal() const override;
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "stats.h"
+
+#include <cstring>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+thread_local RenderStats* activeStats = nullptr;
+thread_local RenderStats::Stage currentStage = RenderStats::Other;
+thread_local Clock::time_point lastSwitch;
+
+// charges the time since the last switch to the current stage
+static void charge(RenderStats* stats, Clock::time_point now)
+{
+	stats->stageSeconds[currentStage] += std::chrono::duration<double>(now - lastSwitch).count();
+	lastSwitch = now;
+}
+
+unsigned long long RenderStats::totalRays() const
+{
+	return primaryRays + shadowRays + reflectionRays + refractionRays;
+}
+
+void RenderStats::countShapeTest(const char* type, bool hit)
+{
+	// only a handful of shape types, a linear search beats any map
+	for (auto& counters : shapes)
+	{
+		if (counters.type == type || strcmp(counters.type, type) == 0)
+		{
+			counters.tests++;
+			counters.hits += hit ? 1 : 0;
+			return;
+		}
+	}
+	shapes.push_back({ type, 1, hit ? 1ull : 0ull });
+}
+
+void RenderStats::merge(const RenderStats& other)
+{
+	primaryRays += other.primaryRays;
+	shadowRays += other.shadowRays;
+	reflectionRays += other.reflectionRays;
+	refractionRays += other.refractionRays;
+	intersectionsAllocations += other.intersectionsAllocations;
+	antialiasedPixels += other.antialiasedPixels;
+	antialiasingRays += other.antialiasingRays;
+	for (const auto& counters : other.shapes)
+	{
+		bool found = false;
+		for (auto& own : shapes)
+		{
+			if (strcmp(own.type, counters.type) == 0)
+			{
+				own.tests += counters.tests;
+				own.hits += counters.hits;
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			shapes.push_back(counters);
+	}
+	for (int i = 0; i < StageCount; i++)
+		stageSeconds[i] += other.stageSeconds[i];
+}
+
+std::string RenderStats::toJson() const
+{
+	std::stringstream ss;
+	ss << "{" << std::endl;
+	ss << "  \"seconds\": " << seconds << "," << std::endl;
+	ss << "  \"mraysPerSecond\": " << (seconds > 0. ? totalRays() / seconds / 1e6 : 0.) << "," << std::endl;
+	ss << "  \"rays\": { \"primary\": " << primaryRays << ", \"shadow\": " << shadowRays << ", \"reflection\": " << reflectionRays
+		<< ", \"refraction\": " << refractionRays << ", \"total\": " << totalRays() << " }," << std::endl;
+
+	ss << "  \"shapes\": {";
+	for (size_t i = 0; i < shapes.size(); i++)
+		ss << (i > 0 ? ", " : " ") << "\"" << shapes[i].type << "\": { \"tests\": " << shapes[i].tests << ", \"hits\": " << shapes[i].hits << " }";
+	ss << (shapes.empty() ? "}," : " },") << std::endl;
+
+	ss << "  \"intersectionsAllocations\": " << intersectionsAllocations << "," << std::endl;
+	ss << "  \"antialiasing\": { \"pixels\": " << antialiasedPixels << ", \"rays\": " << antialiasingRays << " }," << std::endl;
+
+	ss << "  \"stageSeconds\": {";
+	for (int i = 0; i < StageCount; i++)
+		ss << (i > 0 ? ", " : " ") << "\"" << stageName((Stage)i) << "\": " << stageSeconds[i];
+	ss << " }" << std::endl;
+	ss << "}" << std::endl;
+
+	return ss.str();
+}
+
+RenderStats* RenderStats::active()
+{
+	return activeStats;
+}
+
+void RenderStats::setActive(RenderStats* stats)
+{
+	auto now = Clock::now();
+	if (activeStats != nullptr)
+		charge(activeStats, now);
+
+	activeStats = stats;
+	currentStage = Other;
+	lastSwitch = now;
+}
+
+const char* RenderStats::stageName(Stage stage)
+{
+	switch (stage)
+	{
+	case Camera:
+		return "camera";
+	case Intersect:
+		return "intersect";
+	case Shading:
+		return "shading";
+	case Shadows:
+		return "shadows";
+	default:
+		return "other";
+	}
+}
+
+StageTimer::StageTimer(RenderStats::Stage stage)
+	: stats(activeStats), previous(currentStage)
+{
+	if (stats == nullptr)
+		return;
+
+	charge(stats, Clock::now());
+	currentStage = stage;
+}
+
+StageTimer::~StageTimer()
+{
+	if (stats == nullptr)
+		return;
+
+	charge(stats, Clock::now());
+	currentStage = previous;
+}
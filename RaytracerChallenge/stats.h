@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Counters and stage times of a render. Every thread counts into its own instance, so counting needs no
+// synchronization, and the instances are merged once the threads are done.
+struct RenderStats
+{
+	enum Stage
+	{
+		Other,
+		Camera,		// primary ray generation
+		Intersect,	// finding the hit of camera, reflection and refraction rays
+		Shading,	// lighting of a hit, without its shadow rays
+		Shadows,
+		StageCount
+	};
+
+	struct ShapeCounters
+	{
+		const char* type;
+		unsigned long long tests;
+		unsigned long long hits;
+	};
+
+	unsigned long long primaryRays = 0;
+	unsigned long long shadowRays = 0;
+	unsigned long long reflectionRays = 0;
+	unsigned long long refractionRays = 0;
+	unsigned long long intersectionsAllocations = 0;
+	// pixels resampled by antialiasing and the rays it added, which are also counted as primary rays
+	unsigned long long antialiasedPixels = 0;
+	unsigned long long antialiasingRays = 0;
+	std::vector<ShapeCounters> shapes;
+	double stageSeconds[StageCount] = {};
+	double seconds = 0.;
+
+	unsigned long long totalRays() const;
+	// a test hits if it finds at least one intersection
+	void countShapeTest(const char* type, bool hit);
+	void merge(const RenderStats& other);
+
+	std::string toJson() const;
+
+	// The instance the calling thread counts into, null unless a render collecting stats runs on it.
+	static RenderStats* active();
+	static void setActive(RenderStats* stats);
+
+	static const char* stageName(Stage stage);
+};
+
+// Charges the time until it goes out of scope to a stage of the active stats, minus the time of the timers
+// nested in it. Does nothing if the thread isn't collecting stats.
+class StageTimer
+{
+private:
+	RenderStats* stats;
+	RenderStats::Stage previous;
+
+public:
+	StageTimer(RenderStats::Stage stage);
+	~StageTimer();
+
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+};
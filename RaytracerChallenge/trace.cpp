@@ -0,0 +1,143 @@
+#include "trace.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct TraceEvent
+{
+	const char* name;
+	long long start;	// microseconds since the trace origin
+	long long duration;
+};
+
+// Events of one track. A thread appends to the track it holds, the lock is only taken to pick up and hand back
+// a track. Tracks are reused by later threads in the same role, so workers started for every pass don't add tracks.
+struct ThreadEvents
+{
+	unsigned int id;
+	int worker;	// index of the worker slot, -1 for other threads
+	bool busy;	// held by a thread
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex threadsMutex;
+static std::vector<std::unique_ptr<ThreadEvents>> threads;
+static const Clock::time_point origin = Clock::now();
+
+// the track a thread holds, handed back when the thread ends
+struct TrackHolder
+{
+	ThreadEvents* track = nullptr;
+	int worker = -1;
+
+	~TrackHolder()
+	{
+		release();
+	}
+
+	void release()
+	{
+		if (track == nullptr)
+			return;
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		track->busy = false;
+		track = nullptr;
+	}
+};
+
+static thread_local TrackHolder holder;
+
+static ThreadEvents& localEvents()
+{
+	if (holder.track == nullptr || holder.track->worker != holder.worker)
+	{
+		holder.release();
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		for (auto& thread : threads)
+		{
+			if (!thread->busy && thread->worker == holder.worker)
+			{
+				holder.track = thread.get();
+				break;
+			}
+		}
+		if (holder.track == nullptr)
+		{
+			threads.push_back(std::make_unique<ThreadEvents>());
+			holder.track = threads.back().get();
+			holder.track->id = (unsigned int)threads.size();
+			holder.track->worker = holder.worker;
+		}
+		holder.track->busy = true;
+	}
+	return *holder.track;
+}
+
+void Trace::setWorker(unsigned int index)
+{
+	holder.worker = (int)index;
+}
+
+TraceScope::TraceScope(const char* name)
+	: name(name), start(Clock::now())
+{
+}
+
+TraceScope::~TraceScope()
+{
+	auto end = Clock::now();
+	auto micros = [](Clock::duration d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+	localEvents().events.push_back({ name, micros(start - origin), micros(end - start) });
+}
+
+std::string Trace::toJson()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+
+	std::stringstream ss;
+	ss << "{ \"traceEvents\": [" << std::endl;
+	bool first = true;
+	for (const auto& thread : threads)
+	{
+		if (thread->events.empty())
+			continue;
+
+		ss << (first ? "" : ",\n") << "  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+			<< ", \"args\": { \"name\": \"";
+		if (thread->worker >= 0)
+			ss << "worker " << thread->worker + 1;
+		else
+			ss << "thread " << thread->id;
+		ss << "\" } }";
+		first = false;
+
+		for (const auto& e : thread->events)
+		{
+			ss << ",\n  { \"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id
+				<< ", \"ts\": " << e.start << ", \"dur\": " << e.duration << " }";
+		}
+	}
+	ss << std::endl << "] }" << std::endl;
+
+	return ss.str();
+}
+
+void Trace::save(const std::string& path)
+{
+	std::ofstream file;
+	file.open(path);
+	file << toJson();
+	file.close();
+}
+
+void Trace::clear()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (auto& thread : threads)
+		thread->events.clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Scoped timers written as a Chrome/Perfetto trace (chrome://tracing or ui.perfetto.dev) with one track per
+// worker slot of Camera::runWorkers and one per other thread running at the same time. TRACE_SCOPE is compiled out
+// unless RAYTRACER_TRACE is defined.
+#ifdef RAYTRACER_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+class TraceScope
+{
+private:
+	const char* name;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	// name has to outlive the trace, string literals are fine
+	TraceScope(const char* name);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+class Trace
+{
+public:
+	// Puts the events of the calling thread on the track of worker slot index, which the workers with that index
+	// share across runs.
+	static void setWorker(unsigned int index);
+
+	// Only call these while no thread is inside a TraceScope.
+	static std::string toJson();
+	static void save(const std::string& path);
+	static void clear();
+};
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <sstream>
 #include <iomanip>
 #include "tuple.h"
@@ -0,0 +1,307 @@
+#include "wavefront.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "intersection.h"
+#include "sampler.h"
+#include "stats.h"
+#include "trace.h"
+#include "world.h"
+
+// Rays waiting for a stage, one entry per ray in each array, with the pixel of the batch each one adds to.
+struct RayQueue
+{
+	std::vector<Ray> rays;
+	std::vector<float> weights;
+	std::vector<unsigned int> remaining;
+	std::vector<unsigned int> pixels;
+
+	size_t size() const
+	{
+		return rays.size();
+	}
+
+	void clear()
+	{
+		rays.clear();
+		weights.clear();
+		remaining.clear();
+		pixels.clear();
+	}
+
+	void push(const PendingRay& pending, unsigned int pixel)
+	{
+		rays.push_back(pending.ray);
+		weights.push_back(pending.weight);
+		remaining.push_back(pending.remaining);
+		pixels.push_back(pixel);
+	}
+
+	void resize(size_t size)
+	{
+		rays.resize(size);
+		weights.resize(size);
+		remaining.resize(size);
+		pixels.resize(size);
+	}
+};
+
+struct ShadowQueue
+{
+	std::vector<Ray> rays;
+	std::vector<float> distances;
+	std::vector<Color> lights;	// already scaled by the weight of the ray that was shaded
+	std::vector<unsigned int> pixels;
+
+	size_t size() const
+	{
+		return rays.size();
+	}
+
+	void clear()
+	{
+		rays.clear();
+		distances.clear();
+		lights.clear();
+		pixels.clear();
+	}
+
+	void push(const ShadowRay& shadow, float weight, unsigned int pixel)
+	{
+		rays.push_back(shadow.ray);
+		distances.push_back(shadow.distance);
+		lights.push_back(shadow.light * weight);
+		pixels.push_back(pixel);
+	}
+};
+
+// Storage reused by every batch rendered on a thread
+struct WavefrontScratch
+{
+	RayQueue queue;
+	RayQueue next;
+	ShadowQueue shadows;
+	std::vector<Intersections> xs;
+	std::vector<Ray> cameraRays;
+	std::vector<Color> colors;
+	std::vector<ShadowRay> hitShadows;
+	std::vector<PendingRay> spawned;
+	std::vector<unsigned int> bins;
+	std::vector<unsigned int> order;
+};
+
+static const unsigned int gridBits = 3;	// cells per axis of the origin grid is 1 << gridBits
+
+// octant of the direction, then the morton code of the origin's cell
+static unsigned int sortKey(const Ray& ray, const Tuple& low, const Tuple& scale)
+{
+	const unsigned int cells = 1u << gridBits;
+	unsigned int cx = std::min(cells - 1, (unsigned int)((ray.origin.x - low.x) * scale.x));
+	unsigned int cy = std::min(cells - 1, (unsigned int)((ray.origin.y - low.y) * scale.y));
+	unsigned int cz = std::min(cells - 1, (unsigned int)((ray.origin.z - low.z) * scale.z));
+
+	unsigned int morton = 0;
+	for (unsigned int bit = 0; bit < gridBits; bit++)
+		morton |= (((cx >> bit) & 1) << (3 * bit)) | (((cy >> bit) & 1) << (3 * bit + 1)) | (((cz >> bit) & 1) << (3 * bit + 2));
+
+	unsigned int octant = (ray.direction.x < 0.f ? 1 : 0) | (ray.direction.y < 0.f ? 2 : 0) | (ray.direction.z < 0.f ? 4 : 0);
+	return (octant << (3 * gridBits)) | morton;
+}
+
+// Counting sort of the queue by sortKey, rays with the same key keep their order. other is used as storage.
+static void sortRays(RayQueue& queue, RayQueue& other, WavefrontScratch& s)
+{
+	TRACE_SCOPE("sort");
+	auto low = queue.rays[0].origin;
+	auto high = low;
+	for (const auto& ray : queue.rays)
+	{
+		low = Tuple::point(std::min(low.x, ray.origin.x), std::min(low.y, ray.origin.y), std::min(low.z, ray.origin.z));
+		high = Tuple::point(std::max(high.x, ray.origin.x), std::max(high.y, ray.origin.y), std::max(high.z, ray.origin.z));
+	}
+	const float cells = (float)(1u << gridBits);
+	auto extent = high - low;
+	auto scale = Tuple::vector(extent.x > 0.f ? cells / extent.x : 0.f, extent.y > 0.f ? cells / extent.y : 0.f, extent.z > 0.f ? cells / extent.z : 0.f);
+
+	s.bins.assign((8u << (3 * gridBits)) + 1, 0);
+	s.order.resize(queue.size());
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		s.order[i] = sortKey(queue.rays[i], low, scale);
+		s.bins[s.order[i] + 1]++;
+	}
+	for (size_t b = 1; b < s.bins.size(); b++)
+		s.bins[b] += s.bins[b - 1];
+
+	other.resize(queue.size());
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		unsigned int to = s.bins[s.order[i]]++;
+		other.rays[to] = queue.rays[i];
+		other.weights[to] = queue.weights[i];
+		other.remaining[to] = queue.remaining[i];
+		other.pixels[to] = queue.pixels[i];
+	}
+	std::swap(queue, other);
+}
+
+// Traces count pixels starting at the first-th of the frame into colors.
+static void renderBatch(const World& world, const Camera& camera, unsigned int first, unsigned int count, bool sortSecondary, WavefrontScratch& s)
+{
+	auto stats = RenderStats::active();
+	const unsigned int width = camera.getWidth();
+
+	s.colors.assign(count, Color(0));
+	s.queue.clear();
+	{
+		StageTimer timer(RenderStats::Camera);
+		s.cameraRays.clear();
+		camera.getRays(first, count, s.cameraRays);
+		for (unsigned int i = 0; i < count; i++)
+			s.queue.push({ s.cameraRays[i], 1.f, camera.getMaxBounces() }, i);
+	}
+	if (stats != nullptr)
+		stats->primaryRays += count;
+
+	for (bool secondary = false; s.queue.size() > 0; secondary = true)
+	{
+		// rays that can't visibly change their pixel are dropped
+		size_t kept = 0;
+		for (size_t i = 0; i < s.queue.size(); i++)
+		{
+			PendingRay pending = { s.queue.rays[i], s.queue.weights[i], s.queue.remaining[i] };
+			if (!world.survives(pending))
+				continue;
+			s.queue.rays[kept] = pending.ray;
+			s.queue.weights[kept] = pending.weight;
+			s.queue.remaining[kept] = pending.remaining;
+			s.queue.pixels[kept] = s.queue.pixels[i];
+			kept++;
+		}
+		s.queue.resize(kept);
+		if (secondary && sortSecondary && kept > 1)
+			sortRays(s.queue, s.next, s);
+
+		{
+			TRACE_SCOPE("intersect");
+			StageTimer timer(RenderStats::Intersect);
+			world.intersect(s.queue.rays, s.xs);
+		}
+
+		s.next.clear();
+		s.shadows.clear();
+		{
+			TRACE_SCOPE("shade");
+			StageTimer timer(RenderStats::Shading);
+			for (size_t i = 0; i < s.queue.size(); i++)
+			{
+				auto hit = s.xs[i].hit();
+				if (hit == nullptr)
+					continue;
+
+				unsigned int pixel = s.queue.pixels[i];
+				float weight = s.queue.weights[i];
+				Sampler::setCurrent({ (first + pixel) % width, (first + pixel) / width, 0 });
+
+				auto comps = hit->prepare(s.queue.rays[i], s.xs[i]);
+				s.hitShadows.clear();
+				s.colors[pixel] = s.colors[pixel] + comps.surfaceColor(world, &s.hitShadows) * weight;
+				for (const auto& shadow : s.hitShadows)
+					s.shadows.push(shadow, weight, pixel);
+
+				s.spawned.clear();
+				comps.spawn(weight, s.queue.remaining[i], s.spawned);
+				for (const auto& pending : s.spawned)
+					s.next.push(pending, pixel);
+			}
+		}
+
+		if (s.shadows.size() > 0)
+		{
+			TRACE_SCOPE("shadows");
+			StageTimer timer(RenderStats::Shadows);
+			if (stats != nullptr)
+				stats->shadowRays += s.shadows.size();
+
+			world.intersect(s.shadows.rays, s.xs);
+			for (size_t i = 0; i < s.shadows.size(); i++)
+			{
+				auto hit = s.xs[i].hit();
+				if (hit == nullptr || hit->t >= s.shadows.distances[i])
+					s.colors[s.shadows.pixels[i]] = s.colors[s.shadows.pixels[i]] + s.shadows.lights[i];
+			}
+		}
+
+		std::swap(s.queue, s.next);
+	}
+}
+
+Wavefront::Wavefront(unsigned int batchSize)
+	: batchSize(std::max(1u, batchSize)), sortSecondary(false)
+{
+}
+
+unsigned int Wavefront::getBatchSize() const
+{
+	return batchSize;
+}
+
+void Wavefront::setBatchSize(unsigned int batchSize)
+{
+	this->batchSize = std::max(1u, batchSize);
+}
+
+bool Wavefront::getSortSecondary() const
+{
+	return sortSecondary;
+}
+
+void Wavefront::setSortSecondary(bool sort)
+{
+	sortSecondary = sort;
+}
+
+Canvas Wavefront::render(const World& world, const Camera& camera) const
+{
+	auto image = Canvas(camera.getWidth(), camera.getHeight());
+	renderBatches(world, camera, image);
+	return image;
+}
+
+RenderResult Wavefront::renderWithStats(const World& world, const Camera& camera) const
+{
+	RenderStats stats;
+	RenderStats::setActive(&stats);
+
+	auto image = Canvas(camera.getWidth(), camera.getHeight());
+	auto start = std::chrono::steady_clock::now();
+	renderBatches(world, camera, image);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	RenderStats::setActive(nullptr);
+	return { image, stats, Canvas(0, 0) };
+}
+
+void Wavefront::renderBatches(const World& world, const Camera& camera, Canvas& image) const
+{
+	TRACE_SCOPE("render wavefront");
+	const unsigned int width = camera.getWidth();
+	const unsigned int pixels = width * camera.getHeight();
+	std::atomic<unsigned int> nextBatch = 0;
+
+	auto work = [&]() {
+		thread_local WavefrontScratch s;
+		for (unsigned int first = batchSize * nextBatch++; first < pixels; first = batchSize * nextBatch++)
+		{
+			TRACE_SCOPE("render batch");
+			unsigned int count = std::min(batchSize, pixels - first);
+			renderBatch(world, camera, first, count, sortSecondary, s);
+			for (unsigned int i = 0; i < count; i++)
+				image.writePixel((first + i) % width, (first + i) / width, s.colors[i]);
+		}
+	};
+
+	camera.runWorkers(work);
+}
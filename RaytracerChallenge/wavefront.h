@@ -0,0 +1,43 @@
+#pragma once
+
+#include "camera.h"
+#include "canvas.h"
+
+class World;
+
+// Renders batches of pixels one stage at a time instead of following every ray of a pixel to the end. The camera
+// rays of a batch are generated together, then the queued rays go through these stages until none are left:
+//   intersect  every shape against all queued rays, see World::intersect
+//   shade      lighting of the hits, queueing the shadow rays of point lights and the spawned secondary rays
+//   shadows    all queued shadow rays, adding the light of those that reach it
+// Every stage runs over the whole queue, so its code and the data it reads stay in cache. Reflected and refracted
+// rays can be sorted before they are traced, see setSortSecondary.
+//
+// The image matches Camera::render up to rounding, the contributions to a pixel are summed in another order. Pixels
+// are traced through their center only, there is no antialiasing and no pixel cost.
+class Wavefront
+{
+private:
+	unsigned int batchSize;
+	bool sortSecondary;
+
+public:
+	explicit Wavefront(unsigned int batchSize = 4096);
+
+	unsigned int getBatchSize() const;
+	void setBatchSize(unsigned int batchSize);
+	// Bins the queued secondary rays by the octant of their direction, then by the cell of their origin in an 8x8x8
+	// grid over the origins of the queue, so rays that are traced one after the other leave from the same part of
+	// the scene in the same direction. Off by default. Changes the order contributions are summed in, so the image
+	// differs from an unsorted render by rounding.
+	bool getSortSecondary() const;
+	void setSortSecondary(bool sort);
+
+	// Batches are handed out to the threads of the camera, see Camera::setThreads.
+	Canvas render(const World& world, const Camera& camera) const;
+	// Same, counting rays, shape tests and the time spent per stage like Camera::renderWithStats.
+	RenderResult renderWithStats(const World& world, const Camera& camera) const;
+
+private:
+	void renderBatches(const World& world, const Camera& camera, Canvas& image) const;
+};
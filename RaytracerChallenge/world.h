@@ -4,17 +4,62 @@
 #include <memory>
 
 #include "light.h"
+#include "lighttree.h"
+#include "material.h"
 #include "intersection.h"
+#include "shape.h"
 
 class Shape;
+class Sampler;
+
+// What the rays a thread traces while the log is active on it depend on, to find out what an edit of the world
+// affects: the objects they hit and the space they pass through. Its size doesn't grow with the number of rays.
+struct RayLog
+{
+	// rays hitting nothing that start in origins with their direction in directions
+	struct Misses
+	{
+		Bounds origins;
+		Bounds directions;
+	};
+
+	static constexpr unsigned int maxSegments = 16;
+	static constexpr unsigned int maxMisses = 8;
+
+	std::vector<const Shape*> hits;	// every object hit, once
+	// Boxes around the rays up to where another object would change the result: the hit, for shadow rays the light,
+	// or nothing past the origin if they are blocked. Rays are cut at distances 1, 2, 4 and so on, every piece gets
+	// a box of its own until there are maxSegments, then grows the one it grows the least.
+	std::vector<Bounds> segments;
+	// grouped the same way, up to maxMisses
+	std::vector<Misses> misses;
+
+	void clear();
+	// length is infinite for a miss
+	void add(const Ray& ray, float length, const Shape* hit);
+	// whether an object within bounds can be in the way of a ray
+	bool mayHit(const Bounds& bounds) const;
+
+	// The log the calling thread records into, null unless one was set on it.
+	static RayLog* active();
+	static void setActive(RayLog* log);
+};
 
 class World
 {
 private:
 	std::vector<Shape*> objects;
+	std::unique_ptr<MaterialLibrary> materials;
+
+	float lightThreshold;
+	float rayThreshold;
+	bool russianRoulette;
+	LightTree lightTree;
+	const Sampler* sampler;
 
 public:
-	Light light;
+	std::vector<PointLight> lights;
+	std::vector<AreaLight> areaLights;
 
 
 public:
@@ -26,12 +71,65 @@ public:
 
 	size_t getObjectCount() const;
 	bool contains(const Shape& p) const;
+	// The material of p moves into the library of the world, unless it is already stored there.
 	void addObject(Shape* p);
 	Shape* getObject(size_t index);
+	const Shape* getObject(size_t index) const;
+
+	// Materials stored here are shared by every shape that is assigned the returned handle. Edit them through
+	// getMaterials() to change them for all of these shapes, writing through a handle copies the material.
+	MaterialRef addMaterial(const Material& m);
+	MaterialLibrary& getMaterials();
+
+	// Lights whose unshadowed contribution at a point stays below this are skipped without a shadow ray.
+	float getLightThreshold() const;
+	void setLightThreshold(float threshold);
+
+	// Secondary rays whose weight (the product of reflective, transparency, ... along the path) falls below the
+	// threshold are not traced. With russian roulette they survive with a probability of weight / threshold instead
+	// and carry the threshold as weight, which keeps the image unbiased.
+	float getRayThreshold() const;
+	void setRayThreshold(float threshold);
+	bool getRussianRoulette() const;
+	void setRussianRoulette(bool enabled);
+
+	// Positions of the shadow rays on area lights in the penumbra, the regular grid if null. Not owned.
+	const Sampler* getSampler() const;
+	void setSampler(const Sampler* sampler);
+
+	// Shading walks the light tree instead of every light once it is built. Rebuild it after changing lights.
+	void buildLightTree();
+	const LightTree& getLightTree() const;
+
 	Intersections intersect(const Ray& ray) const;
+	// same as above but reuses the storage of xs
+	void intersect(const Ray& ray, Intersections& xs) const;
+	// Same for a batch of rays, xs[i] receives the intersections of rays[i]. Every shape is tested against all
+	// rays before the next one.
+	void intersect(const std::vector<Ray>& rays, std::vector<Intersections>& xs) const;
+
+	// False if the ray is dropped for its weight, see setRayThreshold. Survivors of russian roulette get the
+	// threshold as weight.
+	bool survives(PendingRay& pending) const;
 
-	Color colorAt(const Ray& r, unsigned int remaining) const;
+	// Shading runs in a loop over a stack of pending rays instead of recursing for every bounce.
+	// If hit isn't null it receives the object hit by r, null for a miss, and distance the t of that hit.
+	Color colorAt(const Ray& r, unsigned int remaining, const Shape** hit = nullptr, float* distance = nullptr) const;
+	// color of the reflected and refracted rays spawned by a hit
+	Color traceSecondary(const Computations& comps, unsigned int remaining) const;
 
-	bool isShadowed(const Tuple& point) const;
+	bool isShadowed(const Tuple& point, const Light& light) const;
+	// Fraction of the light visible from point. Area lights start with a few shadow rays and only
+	// take all of their samples when those disagree, i.e. in the penumbra.
+	float visibility(const Tuple& point, const Light& light) const;
+	// Same, but the shadow rays leave from the surface of the hit instead of an arbitrary point.
+	float visibility(const Computations& comps, const Light& light) const;
+
+private:
+	// appends the intersections of ray with o, unsorted
+	void intersect(const Shape& o, const Matrix<4, 4>& inverseTransform, const Ray& ray, Intersections& xs) const;
+	float visibility(const Tuple& point, const Light& light, const Computations* from) const;
+	bool isOccluded(const Tuple& point, const Tuple& target, const Computations* from) const;
+	Color trace(size_t base, const Shape** firstHit = nullptr, float* firstDistance = nullptr) const;
 };
 
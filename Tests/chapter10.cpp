@@ -127,7 +127,7 @@ namespace Tests
 		{
 			auto pattern = TestPattern();
 
-			Assert::AreEqual(Matrix<4, 4>::identity(), pattern.transform);
+			Assert::AreEqual<Matrix<4, 4>>(Matrix<4, 4>::identity(), pattern.transform);
 		}
 
 		TEST_METHOD(TestAssignTransform)
@@ -135,7 +135,8 @@ namespace Tests
 			auto pattern = TestPattern();
 			pattern.transform = translation(1, 2, 3);
 
-			Assert::AreEqual(translation(1, 2, 3), pattern.transform);
+			Assert::AreEqual<Matrix<4, 4>>(translation(1, 2, 3), pattern.transform);
+			Assert::AreEqual(translation(-1, -2, -3), pattern.transform.getInverse());
 		}
 
 		TEST_METHOD(TestPatternWithObjectTransformation)
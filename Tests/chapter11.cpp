@@ -44,7 +44,7 @@ namespace Tests
 
 			auto comps = i.prepare(r);
 
-			Assert::AreEqual(Tuple::vector(0, sqrtHalf, sqrtHalf), comps.reflectv);
+			Assert::AreEqual(Tuple::vector(0, sqrtHalf, sqrtHalf), comps.reflectv());
 		}
 
 		TEST_METHOD(TestReflectForNonreflective)
@@ -52,7 +52,7 @@ namespace Tests
 			auto w = World::Default();
 			auto r = Ray(Tuple::point(0, 0, 0), Tuple::vector(0, 0, 1));
 			auto shape = w.getObject(1);
-			shape->material.ambient = 1;
+			shape->material->ambient = 1;
 			auto i = Intersection(1, shape);
 
 			auto comps = i.prepare(r);
@@ -65,7 +65,7 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto shape = Plane();
-			shape.material.reflective = 0.5;
+			shape.material->reflective = 0.5;
 			shape.transform = translation(0, -1, 0);
 			w.addObject(&shape);
 			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
@@ -81,7 +81,7 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto shape = Plane();
-			shape.material.reflective = 0.5;
+			shape.material->reflective = 0.5;
 			shape.transform = translation(0, -1, 0);
 			w.addObject(&shape);
 			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
@@ -96,13 +96,13 @@ namespace Tests
 		TEST_METHOD(TestMutuallyReflective)
 		{
 			auto w = World();
-			w.light = PointLight(Tuple::point(0, 0, 0), white);
+			w.lights = { PointLight(Tuple::point(0, 0, 0), white) };
 			auto lower = Plane();
-			lower.material.reflective = 1;
+			lower.material->reflective = 1;
 			lower.transform = translation(0, -1, 0);
 			w.addObject(&lower);
 			auto upper = Plane();
-			upper.material.reflective = 1;
+			upper.material->reflective = 1;
 			upper.transform = translation(0, 1, 0);
 			w.addObject(&upper);
 			auto r = Ray(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0));
@@ -110,11 +110,72 @@ namespace Tests
 			Assert::AreEqual(Color(20.9), w.colorAt(r, 10));
 		}
 
+		TEST_METHOD(TestManyBouncesDontRecurse)
+		{
+			auto w = World();
+			w.lights = { PointLight(Tuple::point(0, 0, 0), white) };
+			auto lower = Plane();
+			lower.material->reflective = 1;
+			lower.transform = translation(0, -1, 0);
+			w.addObject(&lower);
+			auto upper = Plane();
+			upper.material->reflective = 1;
+			upper.transform = translation(0, 1, 0);
+			w.addObject(&upper);
+			auto r = Ray(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0));
+
+			// far deeper than the native stack could handle with one frame per bounce
+			auto c = w.colorAt(r, 100000);
+
+			Assert::IsTrue(c.r > 1000.f);
+		}
+
+		TEST_METHOD(TestFaintReflectionNotTraced)
+		{
+			auto w = World::Default();
+			w.setRayThreshold(0.6f);
+			auto shape = Plane();
+			shape.material->reflective = 0.5;
+			shape.transform = translation(0, -1, 0);
+			w.addObject(&shape);
+			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
+			auto i = Intersection(sqrtTwo, &shape);
+
+			auto comps = i.prepare(r);
+			auto color = comps.shade(w, 5);
+
+			Assert::AreEqual(comps.surfaceColor(w), color);
+		}
+
+		TEST_METHOD(TestRussianRouletteKeepsExpectedValue)
+		{
+			auto w = World();
+			w.setRayThreshold(0.6f);
+			w.setRussianRoulette(true);
+
+			// rays of weight 0.3 survive half of the time and carry 0.6, on average their weight stays the same
+			const int count = 10000;
+			float sum = 0.f;
+			int survivors = 0;
+			for (int i = 0; i < count; i++)
+			{
+				auto pending = PendingRay{ Ray(Tuple::point(i * 0.01f, 0, 0), Tuple::vector(0, 0, 1)), 0.3f, 5 };
+				if (!w.survives(pending))
+					continue;
+				Assert::AreEqual(0.6f, pending.weight);
+				sum += pending.weight;
+				survivors++;
+			}
+
+			Assert::IsTrue(survivors > 0 && survivors < count);
+			Assert::IsTrue(fabsf(sum / count - 0.3f) < 0.015f);
+		}
+
 		TEST_METHOD(TestMaxRecursiveDepth)
 		{
 			auto w = World::Default();
 			auto shape = Plane();
-			shape.material.reflective = 0.5;
+			shape.material->reflective = 0.5;
 			shape.transform = translation(0, -1, 0);
 			w.addObject(&shape);
 			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
@@ -143,8 +204,8 @@ namespace Tests
 		{
 			auto s = Sphere::glass();
 
-			Assert::AreEqual(1.f, s.material.transparency);
-			Assert::AreEqual(1.5f, s.material.refractiveIndex);
+			Assert::AreEqual(1.f, s.material->transparency);
+			Assert::AreEqual(1.5f, s.material->refractiveIndex);
 		}
 
 		float n1[6] = { 1.0, 1.5, 2.0, 2.5, 2.5, 1.5 };
@@ -154,13 +215,13 @@ namespace Tests
 		{
 			auto a = Sphere::glass();
 			a.transform = scaling(2, 2, 2);
-			a.material.refractiveIndex = 1.5;
+			a.material->refractiveIndex = 1.5;
 			auto b = Sphere::glass();
 			b.transform = translation(0, 0, -0.25f);
-			b.material.refractiveIndex = 2.f;
+			b.material->refractiveIndex = 2.f;
 			auto c = Sphere::glass();
 			c.transform = translation(0, 0, 0.25);
-			c.material.refractiveIndex = 2.5;
+			c.material->refractiveIndex = 2.5;
 			auto r = Ray(Tuple::point(0, 0, -4), Tuple::vector(0, 0, 1));
 			auto xs = Intersections{ Intersection(2, &a), Intersection(2.75, &b), Intersection(3.25, &c), Intersection(4.75, &b), Intersection(5.25, &c), Intersection(6, &a) };
 
@@ -200,6 +261,43 @@ namespace Tests
 			refractiveIntersectionOutline(5);
 		}
 
+		TEST_METHOD(TestOpaqueHitSkipsRefractiveIndices)
+		{
+			auto a = Sphere::glass();
+			a.transform = scaling(2, 2, 2);
+			auto b = Sphere();
+			b.material->refractiveIndex = 2.f;
+			auto r = Ray(Tuple::point(0, 0, -4), Tuple::vector(0, 0, 1));
+			auto xs = Intersections{ Intersection(2, &a), Intersection(3, &b), Intersection(5, &b), Intersection(6, &a) };
+
+			auto comps = xs[1].prepare(r, xs);
+
+			Assert::AreEqual(1.f, comps.n1);
+			Assert::AreEqual(1.f, comps.n2);
+		}
+
+		TEST_METHOD(TestMaterialFlags)
+		{
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+			auto opaque = Sphere();
+			auto reflective = Sphere();
+			reflective.material->reflective = 0.5f;
+			auto transparent = Sphere::glass();
+			auto faint = Sphere();
+			faint.material->reflective = EPSILON / 2;
+			faint.material->transparency = EPSILON / 2;
+
+			Assert::AreEqual(0, (int)Intersection(4, &opaque).prepare(r).flags);
+			Assert::AreEqual((int)Computations::Reflects, (int)Intersection(4, &reflective).prepare(r).flags);
+			Assert::AreEqual((int)Computations::Refracts, (int)Intersection(4, &transparent).prepare(r).flags);
+			// too faint to spawn a ray, so no flag either
+			Assert::AreEqual(0, (int)Intersection(4, &faint).prepare(r).flags);
+
+			std::vector<PendingRay> rays;
+			Intersection(4, &reflective).prepare(r).spawn(1.f, 5, rays);
+			Assert::AreEqual(1ull, rays.size());
+		}
+
 		TEST_METHOD(TestUnderPoint)
 		{
 			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
@@ -210,8 +308,8 @@ namespace Tests
 
 			auto comps = i.prepare(r, xs);
 
-			Assert::IsTrue(EPSILON / 2 < comps.underPoint.z);
-			Assert::IsTrue(comps.point.z < comps.underPoint.z);
+			Assert::IsTrue(EPSILON / 2 < comps.underPoint().z);
+			Assert::IsTrue(comps.point.z < comps.underPoint().z);
 		}
 
 		TEST_METHOD(TestRefractedColorOpaque)
@@ -231,8 +329,8 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto shape = w.getObject(0);
-			shape->material.transparency = 1.0;
-			shape->material.refractiveIndex = 1.5;
+			shape->material->transparency = 1.0;
+			shape->material->refractiveIndex = 1.5;
 			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
 			auto xs = Intersections{ Intersection(4, shape), Intersection(6, shape) };
 
@@ -246,8 +344,8 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto shape = w.getObject(0);
-			shape->material.transparency = 1.0;
-			shape->material.refractiveIndex = 1.5;
+			shape->material->transparency = 1.0;
+			shape->material->refractiveIndex = 1.5;
 			auto r = Ray(Tuple::point(0, 0, sqrtHalf), Tuple::vector(0, 1, 0));
 			auto xs = Intersections{ Intersection(-sqrtHalf, shape), Intersection(sqrtHalf, shape) };
 
@@ -261,12 +359,12 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto a = w.getObject(0);
-			a->material.ambient = 1.0;
+			a->material->ambient = 1.0;
 			auto pattern = TestPattern();
-			a->material.pattern = &pattern;
+			a->material->pattern = &pattern;
 			auto b = w.getObject(1);
-			b->material.transparency = 1.0;
-			b->material.refractiveIndex = 1.5;
+			b->material->transparency = 1.0;
+			b->material->refractiveIndex = 1.5;
 			auto r = Ray(Tuple::point(0, 0, 0.1), Tuple::vector(0, 1, 0));
 			auto xs = Intersections{ Intersection(-0.9899, a), Intersection(-0.4899, b), Intersection(0.4899, b), Intersection(0.9899, a) };
 
@@ -281,12 +379,12 @@ namespace Tests
 			auto w = World::Default();
 			auto floor = Plane();
 			floor.transform = translation(0, -1, 0);
-			floor.material.transparency = 0.5;
-			floor.material.refractiveIndex = 1.5;
+			floor.material->transparency = 0.5;
+			floor.material->refractiveIndex = 1.5;
 			w.addObject(&floor);
 			auto ball = Sphere();
-			ball.material.color = Color(1, 0, 0);
-			ball.material.ambient = 0.5;
+			ball.material->color = Color(1, 0, 0);
+			ball.material->ambient = 0.5;
 			ball.transform = translation(0, -3.5, -0.5);
 			w.addObject(&ball);
 			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
@@ -340,13 +438,13 @@ namespace Tests
 			auto r = Ray(Tuple::point(0, 0, -3), Tuple::vector(0, -sqrtHalf, sqrtHalf));
 			auto floor = Plane();
 			floor.transform = translation(0, -1, 0);
-			floor.material.reflective = 0.5;
-			floor.material.transparency = 0.5;
-			floor.material.refractiveIndex = 1.5;
+			floor.material->reflective = 0.5;
+			floor.material->transparency = 0.5;
+			floor.material->refractiveIndex = 1.5;
 			w.addObject(&floor);
 			auto ball = Sphere();
-			ball.material.color = Color(1, 0, 0);
-			ball.material.ambient = 0.5;
+			ball.material->color = Color(1, 0, 0);
+			ball.material->ambient = 0.5;
 			ball.transform = translation(0, -3.5, -0.5);
 			w.addObject(&ball);
 			auto xs = Intersections{ Intersection(sqrtTwo, &floor) };
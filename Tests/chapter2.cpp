@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "CppUnitTest.h"
+#include <sstream>
 #include "../RaytracerChallenge/color.h"
 #include "../RaytracerChallenge/math.h"
 #include "../RaytracerChallenge/canvas.h"
@@ -147,5 +148,43 @@ namespace Tests
 
 			Assert::IsTrue(ppm.ends_with("\n"));
 		}
+
+		TEST_METHOD(TestCanvasPpmRoundTrip)
+		{
+			auto c = Canvas(10, 2);
+			c.writePixel(0, 0, Color(1, 0.8f, 0.6f));
+			c.writePixel(9, 1, Color(0, 0.2f, 1));
+
+			auto stream = std::stringstream(c.getPPM());
+			auto read = Canvas::fromPPM(stream);
+
+			Assert::AreEqual(10ull, read.width);
+			Assert::AreEqual(2ull, read.height);
+			Assert::IsTrue(Color(1, 0.8f, 0.6f) == read.at(0, 0));
+			Assert::IsTrue(Color(0, 0.2f, 1) == read.at(9, 1));
+			Assert::IsTrue(Color(0, 0, 0) == read.at(5, 1));
+		}
+
+		TEST_METHOD(TestCanvasFingerprint)
+		{
+			auto a = Canvas(4, 3);
+			auto b = Canvas(4, 3);
+			a.writePixel(1, 2, Color(0.25f, 0.5f, 1));
+			b.writePixel(1, 2, Color(0.25f, 0.5f, 1));
+
+			Assert::AreEqual(a.fingerprint(), b.fingerprint());
+
+			b.writePixel(3, 0, Color(0, 0, 1e-7f));
+			Assert::AreNotEqual(a.fingerprint(), b.fingerprint());
+		}
+
+		TEST_METHOD(TestCanvasPpmInvalid)
+		{
+			auto stream = std::stringstream("P6\n2 2\n255\n");
+			Assert::AreEqual(0ull, Canvas::fromPPM(stream).width);
+
+			auto truncated = std::stringstream("P3\n2 1\n255\n255 0 0\n");
+			Assert::AreEqual(0ull, Canvas::fromPPM(truncated).width);
+		}
 	};
 }
\ No newline at end of file
@@ -193,7 +193,7 @@ namespace Tests
 		{
 			auto s = Sphere();
 
-			Assert::AreEqual(Matrix<4, 4>::identity(), s.transform);
+			Assert::AreEqual<Matrix<4, 4>>(Matrix<4, 4>::identity(), s.transform);
 		}
 
 		TEST_METHOD(TestChangeTransform)
@@ -203,7 +203,16 @@ namespace Tests
 
 			s.transform = t;
 
-			Assert::AreEqual(t, s.transform);
+			Assert::AreEqual<Matrix<4, 4>>(t, s.transform);
+		}
+
+		TEST_METHOD(TestTransformKeepsInverse)
+		{
+			auto s = Sphere();
+			s.transform = translation(2, 3, 4);
+			s.transform = scaling(2, 2, 2) * s.transform;
+
+			Assert::AreEqual(inverse(scaling(2, 2, 2) * translation(2, 3, 4)), s.transform.getInverse());
 		}
 
 		TEST_METHOD(TestIntersectScaledRay)
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 #include <iostream>
+#include <utility>
 #include "../RaytracerChallenge/math.h"
 #include "../RaytracerChallenge/ray.h"
 #include "../RaytracerChallenge/shape.h"
@@ -8,6 +9,7 @@
 #include "../RaytracerChallenge/color.h"
 #include "../RaytracerChallenge/light.h"
 #include "../RaytracerChallenge/material.h"
+#include "../RaytracerChallenge/world.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -118,7 +120,7 @@ namespace Tests
 		{
 			auto s = Sphere();
 
-			auto m = s.material;
+			Material m = s.material;
 
 			Assert::AreEqual(Material(), m);
 		}
@@ -131,7 +133,81 @@ namespace Tests
 
 			s.material = m;
 
-			Assert::AreEqual(m, s.material);
+			Assert::AreEqual(m, *s.material);
+		}
+
+		TEST_METHOD(TestShapesShareLibraryMaterial)
+		{
+			auto w = World();
+			auto m = w.addMaterial(Material());
+			auto s1 = Sphere();
+			auto s2 = Sphere();
+
+			s1.material = m;
+			s2.material = m;
+			w.getMaterials()[m.getIndex()].ambient = 1.f;
+
+			Assert::IsTrue(s1.material == s2.material);
+			Assert::AreEqual(1.f, std::as_const(s2).material->ambient);
+			Assert::AreEqual(2ull, w.getMaterials().count());
+		}
+
+		TEST_METHOD(TestSharedMaterialCopiedOnWrite)
+		{
+			auto w = World();
+			auto m = w.addMaterial(Material());
+			auto s1 = Sphere();
+			auto s2 = Sphere();
+			s1.material = m;
+			s2.material = m;
+
+			auto assigned = Material();
+			assigned.ambient = 1.f;
+			s1.material = assigned;
+			Assert::AreEqual(assigned, *std::as_const(s1).material);
+			Assert::AreEqual(Material(), *std::as_const(s2).material);
+			Assert::AreEqual(Material(), *std::as_const(m));
+
+			// writing through a handle, or through a copy of the shape, leaves the others alone as well
+			auto copy = s2;
+			copy.material->diffuse = 0.5f;
+			Assert::AreEqual(0.9f, std::as_const(s2).material->diffuse);
+			Assert::IsTrue(s2.material == m);
+			Assert::IsFalse(copy.material == m);
+		}
+
+		TEST_METHOD(TestDefaultMaterialNotShared)
+		{
+			auto s1 = Sphere();
+			auto s2 = Sphere();
+
+			s1.material->ambient = 1.f;
+
+			Assert::AreEqual(Material(), *s2.material);
+		}
+
+		TEST_METHOD(TestWorldAdoptsShapeMaterial)
+		{
+			auto w = World();
+			auto s = new Sphere();
+			s->material->ambient = 1.f;
+			w.addObject(s);
+
+			Assert::IsTrue(s->material.getLibrary() == &w.getMaterials());
+			Assert::AreEqual(1.f, s->material->ambient);
+			Assert::AreEqual(2ull, w.getMaterials().count());
+
+			// an assigned material gets a slot of its own, references to the old one survive more materials
+			const Material& m = *std::as_const(*s).material;
+			auto m2 = Material();
+			m2.ambient = 0.5f;
+			s->material = m2;
+			for (int i = 0; i < 100; i++)
+				w.addMaterial(Material());
+			Assert::AreEqual(1.f, m.ambient);
+			Assert::AreEqual(0.5f, s->material->ambient);
+			Assert::AreEqual(103ull, w.getMaterials().count());
+			w.dispose();
 		}
 
 	};
@@ -7,6 +7,14 @@
 #include "../RaytracerChallenge/intersection.h"
 #include "../RaytracerChallenge/camera.h"
 #include "../RaytracerChallenge/shape.h"
+#include "../RaytracerChallenge/trace.h"
+#include "../RaytracerChallenge/sampler.h"
+#include "../RaytracerChallenge/scenes.h"
+#include "../RaytracerChallenge/distributed.h"
+#include "../RaytracerChallenge/wavefront.h"
+#include "../RaytracerChallenge/framecache.h"
+#include "../RaytracerChallenge/incremental.h"
+#include <future>
 
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -22,23 +30,23 @@ namespace Tests
 			auto w = World();
 
 			Assert::AreEqual(0ull, w.getObjectCount());
-			Assert::AreEqual(Color(), w.light.intensity);
-			Assert::AreEqual(Tuple(), w.light.position);
+			Assert::AreEqual(0ull, w.lights.size());
 		}
 
 		TEST_METHOD(TestDefaultWorld)
 		{
 			auto light = PointLight(Tuple::point(-10, 10, -10), Color(1, 1, 1));
 			auto s1 = Sphere();
-			s1.material.color = Color(0.8, 1.0, 0.6);
-			s1.material.diffuse = 0.7;
-			s1.material.specular = 0.2;
+			s1.material->color = Color(0.8, 1.0, 0.6);
+			s1.material->diffuse = 0.7;
+			s1.material->specular = 0.2;
 			auto s2 = Sphere();
 			s2.transform = scaling(0.5, 0.5, 0.5);
 
 			auto w = World::Default();
 
-			Assert::AreEqual(light, static_cast<PointLight&>(w.light));
+			Assert::AreEqual(1ull, w.lights.size());
+			Assert::AreEqual(light, w.lights[0]);
 			Assert::AreEqual(2ull, w.getObjectCount());
 			//Assert::IsTrue(w.contains(s1));
 			//Assert::IsTrue(w.contains(s1));
@@ -116,7 +124,7 @@ namespace Tests
 		TEST_METHOD(TestShadeIntersectionFromInside)
 		{
 			auto w = World::Default();
-			w.light = PointLight(Tuple::point(0, 0.25, 0), Color(1, 1, 1));
+			w.lights = { PointLight(Tuple::point(0, 0.25, 0), Color(1, 1, 1)) };
 			auto r = Ray(Tuple::point(0, 0, 0), Tuple::vector(0, 0, 1));
 			auto shape = w.getObject(1);
 			auto i = Intersection(0.5, shape);
@@ -151,14 +159,14 @@ namespace Tests
 		{
 			auto w = World::Default();
 			auto outer = w.getObject(0);
-			outer->material.ambient = 1;
+			outer->material->ambient = 1;
 			auto inner = w.getObject(1);
-			inner->material.ambient = 1;
+			inner->material->ambient = 1;
 			auto r = Ray(Tuple::point(0, 0, 0.75), Tuple::vector(0, 0, -1));
 
 			auto c = w.colorAt(r, 5);
 
-			Assert::AreEqual(inner->material.color, c);
+			Assert::AreEqual(inner->material->color, c);
 		}
 	};
 
@@ -287,5 +295,487 @@ namespace Tests
 
 			Assert::AreEqual(Color(0.38066, 0.47583, 0.2855), image.at(5, 5));
 		}
+
+		TEST_METHOD(TestRenderWithStats)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+
+			auto result = c.renderWithStats(w);
+
+			Assert::AreEqual(Color(0.38066, 0.47583, 0.2855), result.canvas.at(5, 5));
+			Assert::AreEqual(121ull, result.stats.primaryRays);
+			Assert::IsTrue(result.stats.shadowRays > 0);
+			Assert::AreEqual(0ull, result.stats.reflectionRays + result.stats.refractionRays);
+			Assert::AreEqual(1ull, result.stats.shapes.size());
+			Assert::AreEqual(std::string("Sphere"), std::string(result.stats.shapes[0].type));
+			Assert::IsTrue(result.stats.shapes[0].tests >= 2 * 121);
+			Assert::IsTrue(result.stats.toJson().find("\"primary\": 121") != std::string::npos);
+			Assert::IsTrue(RenderStats::active() == nullptr);
+		}
+
+		TEST_METHOD(TestRenderRayCost)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setPixelCost(PixelCost::Rays);
+
+			auto result = c.renderWithStats(w);
+			auto heatmap = result.cost.heatmap();
+
+			// a miss costs just the primary ray, a hit adds a shadow ray
+			Assert::AreEqual(Color(1, 1, 1), result.cost.at(0, 0));
+			Assert::AreEqual(Color(2, 2, 2), result.cost.at(5, 5));
+			Assert::AreEqual(Color(0, 0, 1), heatmap.at(0, 0));
+			Assert::AreEqual(Color(1, 0, 0), heatmap.at(5, 5));
+		}
+
+		TEST_METHOD(TestRenderProgressive)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setThreads(3);
+
+			RenderStats stats;
+			RenderStats::setActive(&stats);
+			std::vector<unsigned long long> raysPerPass;
+			auto image = c.renderProgressive(w, [&](const Canvas& partial, unsigned int pass, unsigned int passes) {
+				Assert::AreEqual(3u, passes);
+				Assert::AreEqual((unsigned int)raysPerPass.size(), pass);
+				raysPerPass.push_back(stats.primaryRays);
+				if (pass == 0)
+					Assert::AreEqual(partial.at(4, 4), partial.at(7, 7));
+			}, 4);
+			RenderStats::setActive(nullptr);
+
+			// 3 x 3 corners of 4 x 4 blocks, then the rest of a 6 x 6 grid, then every other pixel
+			Assert::AreEqual(3ull, raysPerPass.size());
+			Assert::AreEqual(9ull, raysPerPass[0]);
+			Assert::AreEqual(36ull, raysPerPass[1]);
+			Assert::AreEqual(121ull, raysPerPass[2]);
+
+			auto reference = c.render(w);
+			for (unsigned int y = 0; y < 11; y++)
+				for (unsigned int x = 0; x < 11; x++)
+					Assert::AreEqual(reference.at(x, y), image.at(x, y));
+		}
+
+		TEST_METHOD(TestRenderWithinCancelled)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+
+			RenderBudget budget;
+			auto result = c.renderWithin(w, budget, [&](const Canvas&, unsigned int pass, unsigned int) {
+				if (pass == 0)
+					budget.cancel();
+			}, 4);
+
+			// only the 3 x 3 pixels of the first pass, filling their blocks
+			Assert::AreEqual(9.f / 121.f, result.completed, 1e-6f);
+			Assert::AreEqual(c.render(w).at(4, 4), result.canvas.at(7, 7));
+
+			budget.cancel();
+			Assert::AreEqual(0.f, c.renderWithin(w, budget).completed);
+		}
+
+		TEST_METHOD(TestRenderWithinDeadline)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setThreads(2);
+
+			RenderBudget generous(std::chrono::seconds(60));
+			auto result = c.renderWithin(w, generous);
+			Assert::AreEqual(1.f, result.completed);
+			Assert::AreEqual(Color(0.38066, 0.47583, 0.2855), result.canvas.at(5, 5));
+
+			RenderBudget passed(std::chrono::steady_clock::now());
+			Assert::AreEqual(0.f, c.renderWithin(w, passed).completed);
+		}
+
+		TEST_METHOD(TestRenderAntialiasing)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			auto aliased = c.render(w);
+
+			c.setAntialiasing(9);
+			c.setThreads(2);
+			auto result = c.renderWithStats(w);
+
+			// the background is left alone, resampled pixels take 8 rays besides their center
+			Assert::IsTrue(result.stats.antialiasedPixels > 0 && result.stats.antialiasedPixels < 121);
+			Assert::AreEqual(8 * result.stats.antialiasedPixels, result.stats.antialiasingRays);
+			Assert::AreEqual(121 + result.stats.antialiasingRays, result.stats.primaryRays);
+			Assert::AreEqual(aliased.at(0, 0), result.canvas.at(0, 0));
+
+			c.setThreads(1);
+			auto single = c.render(w);
+			for (unsigned int y = 0; y < 11; y++)
+				for (unsigned int x = 0; x < 11; x++)
+					Assert::AreEqual(single.at(x, y), result.canvas.at(x, y));
+		}
+
+		TEST_METHOD(TestRenderAntialiasingWithSampler)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			auto sampler = StratifiedSampler();
+			c.setSampler(&sampler);
+			c.setAntialiasing(9);
+
+			auto result = c.renderWithStats(w);
+			// jittered samples miss the center, so all 9 are traced
+			Assert::AreEqual(9 * result.stats.antialiasedPixels, result.stats.antialiasingRays);
+
+			c.setThreads(3);
+			auto threaded = c.render(w);
+			for (unsigned int y = 0; y < 11; y++)
+				for (unsigned int x = 0; x < 11; x++)
+					Assert::AreEqual(result.canvas.at(x, y), threaded.at(x, y));
+
+			// a regular grid of 5 x 5 has the center as its middle sample
+			auto regular = RegularSampler();
+			c.setSampler(&regular);
+			c.setAntialiasing(25);
+			auto grid = c.renderWithStats(w);
+			Assert::AreEqual(24 * grid.stats.antialiasedPixels, grid.stats.antialiasingRays);
+		}
+
+		TEST_METHOD(TestRenderIsIndependentOfThreads)
+		{
+			auto w = World::Default();
+			auto floor = Plane();
+			floor.transform = translation(0, -1, 0);
+			floor.material = w.addMaterial(Material());
+			floor.material->reflective = 0.3f;
+			w.addObject(&floor);
+			w.areaLights.push_back(AreaLight::rectangle(Tuple::point(-11, 9, -11), Tuple::vector(2, 0, 0), Tuple::vector(0, 0, 2), Color(0.5f)));
+			w.setRussianRoulette(true);
+			w.setRayThreshold(0.5f);
+			auto sampler = BlueNoiseSampler();
+			w.setSampler(&sampler);
+
+			auto c = Camera(23, 17, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 1, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setSampler(&sampler);
+			c.setAntialiasing(16);
+
+			auto expected = c.render(w).fingerprint();
+			for (unsigned int threads : { 2u, 3u, 8u })
+			{
+				c.setThreads(threads);
+				Assert::AreEqual(expected, c.render(w).fingerprint());
+				Assert::AreEqual(expected, c.renderWithStats(w).canvas.fingerprint());
+			}
+
+			c.setAntialiasing(1);
+			Assert::AreEqual(c.render(w).fingerprint(), c.renderProgressive(w, nullptr).fingerprint());
+		}
+
+		TEST_METHOD(TestRenderProgressiveAntialiased)
+		{
+			auto w = World::Default();
+			auto c = Camera(21, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setAntialiasing(9);
+			c.setThreads(2);
+
+			unsigned int calls = 0;
+			unsigned long long last = 0;
+			auto image = c.renderProgressive(w, [&](const Canvas& partial, unsigned int, unsigned int) {
+				calls++;
+				last = partial.fingerprint();
+			});
+
+			auto expected = c.render(w).fingerprint();
+			Assert::AreEqual(4u, calls);
+			Assert::AreEqual(expected, image.fingerprint());
+			Assert::AreEqual(expected, last);
+			c.setAntialiasing(1);
+			Assert::AreNotEqual(expected, c.render(w).fingerprint());
+		}
+
+		TEST_METHOD(TestRenderRegion)
+		{
+			auto w = World::Default();
+			auto c = Camera(11, 11, pi / 2);
+			c.setTransform(viewTransform(Tuple::point(0, 0, -5), Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0)));
+			c.setAntialiasing(9);
+			c.setThreads(2);
+			auto full = c.render(w);
+
+			// antialiasing at the edge of the region still sees the neighbors outside of it
+			auto region = c.renderRegion(w, { 2, 3, 5, 4 });
+			Assert::AreEqual(5ull, region.width);
+			Assert::AreEqual(4ull, region.height);
+			for (unsigned int y = 0; y < 4; y++)
+				for (unsigned int x = 0; x < 5; x++)
+					Assert::AreEqual(full.at(x + 2, y + 3), region.at(x, y));
+
+			// clipped to the frame
+			auto corner = c.renderRegion(w, { 8, 9, 10, 10 });
+			Assert::AreEqual(3ull, corner.width);
+			Assert::AreEqual(2ull, corner.height);
+			Assert::AreEqual(full.at(10, 10), corner.at(2, 1));
+
+			auto target = Canvas(20, 20);
+			c.renderRegion(w, { 4, 4, 3, 3 }, target, 10, 1);
+			Assert::AreEqual(full.at(4, 4), target.at(10, 1));
+			Assert::AreEqual(full.at(6, 6), target.at(12, 3));
+			Assert::AreEqual(Color(0, 0, 0), target.at(13, 3));
+		}
+
+		TEST_METHOD(TestDistributedRender)
+		{
+			TileJob job = { "simpleWorld", 40, 20, 8, 1 };
+			Assert::AreEqual(15u, job.getTileCount());
+			unsigned int x, y, w, h;
+			job.getTile(14, x, y, w, h);
+			Assert::AreEqual(32u, x);
+			Assert::AreEqual(16u, y);
+			Assert::AreEqual(8u, w);
+			Assert::AreEqual(4u, h);
+
+			std::promise<unsigned short> listening;
+			CoordinatorOptions options;
+			options.onListening = [&](unsigned short port) { listening.set_value(port); };
+			auto coordinator = std::async(std::launch::async, [&]() { return coordinateRender(job, options); });
+
+			// the first worker leaves after one tile, the tile it was handed next goes to the other one
+			WorkerOptions leaving;
+			leaving.port = listening.get_future().get();
+			leaving.threads = 1;
+			leaving.maxTiles = 1;
+			Assert::AreEqual(1, runRenderWorker(leaving));
+
+			WorkerOptions staying;
+			staying.port = leaving.port;
+			Assert::AreEqual(14, runRenderWorker(staying));
+
+			auto image = coordinator.get();
+			auto scene = Scene::simpleWorld();
+			auto camera = scene->camera(40, 20);
+			Assert::AreEqual(camera.render(scene->world).fingerprint(), image.fingerprint());
+		}
+
+		TEST_METHOD(TestWavefrontRender)
+		{
+			// reflection, refraction and a plane, rendered in batches that don't end at rows
+			auto scene = Scene::worldRefraction();
+			auto camera = scene->camera(40, 20);
+			camera.setThreads(2);
+			auto expected = camera.renderWithStats(scene->world);
+
+			auto wavefront = Wavefront(50);
+			auto result = wavefront.renderWithStats(scene->world, camera);
+			Assert::AreEqual(expected.stats.primaryRays, result.stats.primaryRays);
+			Assert::AreEqual(expected.stats.shadowRays, result.stats.shadowRays);
+			Assert::AreEqual(expected.stats.reflectionRays, result.stats.reflectionRays);
+			Assert::AreEqual(expected.stats.refractionRays, result.stats.refractionRays);
+			for (unsigned int y = 0; y < 20; y++)
+				for (unsigned int x = 0; x < 40; x++)
+					Assert::AreEqual(expected.canvas.at(x, y), result.canvas.at(x, y));
+
+			camera.setThreads(1);
+			Assert::AreEqual(result.canvas.fingerprint(), wavefront.render(scene->world, camera).fingerprint());
+		}
+
+		TEST_METHOD(TestWavefrontSortSecondary)
+		{
+			auto scene = Scene::sphereGrid(2);
+			auto camera = scene->camera(40, 20);
+			auto wavefront = Wavefront(64);
+			Assert::IsFalse(wavefront.getSortSecondary());
+			auto unsorted = wavefront.renderWithStats(scene->world, camera);
+
+			// the same rays are traced, only in another order
+			wavefront.setSortSecondary(true);
+			auto sorted = wavefront.renderWithStats(scene->world, camera);
+			Assert::AreEqual(unsorted.stats.totalRays(), sorted.stats.totalRays());
+			for (unsigned int y = 0; y < 20; y++)
+				for (unsigned int x = 0; x < 40; x++)
+					Assert::AreEqual(unsorted.canvas.at(x, y), sorted.canvas.at(x, y));
+
+			camera.setThreads(3);
+			Assert::AreEqual(sorted.canvas.fingerprint(), wavefront.render(scene->world, camera).fingerprint());
+		}
+
+		TEST_METHOD(TestFrameCacheReprojects)
+		{
+			auto scene = Scene::worldRefraction();
+			auto camera = scene->camera(40, 20);
+			auto cache = FrameCache();
+			Assert::AreEqual(camera.render(scene->world).fingerprint(), cache.render(scene->world, camera).fingerprint());
+			Assert::AreEqual(800u, cache.getTracedPixels());
+
+			cache.render(scene->world, camera);
+			Assert::AreEqual(0u, cache.getTracedPixels());
+
+			// a small turn traces what came into view and the holes, the rest is reprojected
+			camera.setTransform(rotationY(0.02f) * camera.getTransform());
+			cache.render(scene->world, camera);
+			Assert::AreEqual(800u, cache.getTracedPixels() + cache.getReprojectedPixels());
+			Assert::IsTrue(cache.getTracedPixels() > 0);
+			Assert::IsTrue(cache.getReprojectedPixels() > 600);
+			Assert::AreEqual(cache.getReprojectedPixels(), cache.getPendingPixels());
+
+			RenderBudget cancelled;
+			cancelled.cancel();
+			Assert::IsTrue(cache.refine(scene->world, camera, cancelled).completed < 1.f);
+			Assert::AreEqual(cache.getReprojectedPixels(), cache.getPendingPixels());
+
+			RenderBudget unlimited;
+			auto refined = cache.refine(scene->world, camera, unlimited);
+			Assert::AreEqual(1.f, refined.completed);
+			Assert::AreEqual(0u, cache.getPendingPixels());
+			Assert::AreEqual(camera.render(scene->world).fingerprint(), refined.canvas.fingerprint());
+
+			cache.invalidate();
+			cache.render(scene->world, camera);
+			Assert::AreEqual(800u, cache.getTracedPixels());
+		}
+
+		TEST_METHOD(TestFrameCacheRefinesAntialiasing)
+		{
+			auto scene = Scene::worldRefraction();
+			auto camera = scene->camera(40, 20);
+			camera.setAntialiasing(9);
+			auto cache = FrameCache();
+
+			// the centers alone aren't final
+			cache.render(scene->world, camera);
+			Assert::AreEqual(800u, cache.getTracedPixels());
+			Assert::AreEqual(800u, cache.getPendingPixels());
+
+			float completed = 0.f;
+			unsigned long long fingerprint = 0;
+			cache.startRefine(scene->world, camera, [&](const PartialRender& refined) {
+				completed = refined.completed;
+				fingerprint = refined.canvas.fingerprint();
+			});
+			cache.waitForRefine();
+			Assert::AreEqual(1.f, completed);
+			Assert::AreEqual(0u, cache.getPendingPixels());
+			Assert::AreEqual(camera.render(scene->world).fingerprint(), fingerprint);
+
+			// a turn reprojects, the refine after it gives the antialiased frame again
+			camera.setTransform(rotationY(0.02f) * camera.getTransform());
+			cache.render(scene->world, camera);
+			Assert::AreEqual(800u, cache.getPendingPixels());
+			cache.startRefine(scene->world, camera);
+			cache.stopRefine();
+			RenderBudget unlimited;
+			Assert::AreEqual(camera.render(scene->world).fingerprint(), cache.refine(scene->world, camera, unlimited).canvas.fingerprint());
+		}
+
+		TEST_METHOD(TestIncrementalRender)
+		{
+			auto scene = Scene::worldRefraction();
+			auto camera = scene->camera(40, 20);
+			auto& w = scene->world;
+			auto renderer = IncrementalRenderer(8);
+			Assert::AreEqual(camera.render(w).fingerprint(), renderer.render(w, camera).fingerprint());
+			Assert::AreEqual(15u, renderer.getTileCount());
+			Assert::AreEqual(15u, renderer.getRenderedTiles());
+
+			renderer.render(w, camera);
+			Assert::AreEqual(0u, renderer.getRenderedTiles());
+
+			auto shape = w.getObject(w.getObjectCount() - 1);
+			shape->material->color = Color(0.2f, 0.9f, 0.1f);
+			auto edited = renderer.render(w, camera);
+			Assert::IsTrue(renderer.getRenderedTiles() > 0);
+			Assert::IsTrue(renderer.getRenderedTiles() < 15);
+			Assert::AreEqual(camera.render(w).fingerprint(), edited.fingerprint());
+
+			// tiles the object moves into are rendered as well
+			shape->transform = translation(0.3f, 0, 0) * shape->transform;
+			auto moved = renderer.render(w, camera);
+			Assert::IsTrue(renderer.getRenderedTiles() > 0);
+			Assert::IsTrue(renderer.getRenderedTiles() < 15);
+			Assert::AreEqual(camera.render(w).fingerprint(), moved.fingerprint());
+
+			renderer.invalidate();
+			renderer.render(w, camera);
+			Assert::AreEqual(15u, renderer.getRenderedTiles());
+		}
+
+		TEST_METHOD(TestRayLogBounds)
+		{
+			RayLog log;
+			auto s = Sphere();
+			log.add(Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1)), 4.f, &s);
+			log.add(Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1)), 4.f, &s);
+			log.add(Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 1, 0)), INFINITY, nullptr);
+			Assert::AreEqual((size_t)1, log.hits.size());
+
+			// along the segment up to the hit and along the miss, not past the hit or beside the miss
+			Assert::IsTrue(log.mayHit(Bounds(Tuple::point(-1, -1, -3), Tuple::point(1, 1, -2))));
+			Assert::IsTrue(log.mayHit(Bounds(Tuple::point(-1, 100, -6), Tuple::point(1, 102, -4))));
+			Assert::IsFalse(log.mayHit(Bounds(Tuple::point(-1, -1, 0), Tuple::point(1, 1, 2))));
+			Assert::IsFalse(log.mayHit(Bounds(Tuple::point(3, 100, -6), Tuple::point(5, 102, -4))));
+			Assert::IsFalse(log.mayHit(Bounds(Tuple::point(-1, -10, -6), Tuple::point(1, -8, -4))));
+
+			// the log doesn't grow with the rays
+			for (int i = 0; i < 1000; i++)
+			{
+				log.add(Ray(Tuple::point((float)i, 0, 0), Tuple::vector(0, 0, 1)), 10.f, nullptr);
+				log.add(Ray(Tuple::point((float)i, 0, 0), Tuple::vector(0, 0, -1)), INFINITY, nullptr);
+			}
+			Assert::IsTrue(log.segments.size() <= RayLog::maxSegments);
+			Assert::IsTrue(log.misses.size() <= RayLog::maxMisses);
+			Assert::IsTrue(log.mayHit(Bounds(Tuple::point(500, 0, 9), Tuple::point(500, 0, 9))));
+
+			log.clear();
+			Assert::IsFalse(log.mayHit(Bounds::everything()));
+		}
+
+		TEST_METHOD(TestTraceScopes)
+		{
+			Trace::clear();
+			{
+				TraceScope outer("outer scope");
+				TraceScope inner("inner scope");
+			}
+
+			auto json = Trace::toJson();
+			Trace::clear();
+
+			Assert::IsTrue(json.find("\"name\": \"outer scope\", \"ph\": \"X\"") != std::string::npos);
+			Assert::IsTrue(json.find("\"name\": \"inner scope\", \"ph\": \"X\"") != std::string::npos);
+			Assert::IsTrue(Trace::toJson().find("outer scope") == std::string::npos);
+		}
+
+		TEST_METHOD(TestTraceTrackPerWorker)
+		{
+			auto camera = Camera(4, 4, pi / 2);
+			camera.setThreads(2);
+			Trace::clear();
+			for (int render = 0; render < 2; render++)
+				camera.runWorkers([]() { TraceScope scope("worker scope"); });
+
+			auto json = Trace::toJson();
+			Trace::clear();
+
+			auto count = [&](const std::string& text) {
+				size_t n = 0;
+				for (auto at = json.find(text); at != std::string::npos; at = json.find(text, at + 1))
+					n++;
+				return n;
+			};
+			Assert::AreEqual((size_t)4, count("\"name\": \"worker scope\""));
+			Assert::AreEqual((size_t)2, count("\"args\": { \"name\": \"worker "));
+			Assert::AreEqual((size_t)1, count("\"name\": \"worker 1\""));
+			Assert::AreEqual((size_t)1, count("\"name\": \"worker 2\""));
+		}
 	};
 }
\ No newline at end of file
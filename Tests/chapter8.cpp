@@ -1,11 +1,15 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 #include <iostream>
+#include <algorithm>
 #include "../RaytracerChallenge/math.h"
 #include "../RaytracerChallenge/material.h"
 #include "../RaytracerChallenge/world.h"
 #include "../RaytracerChallenge/shape.h"
 #include "../RaytracerChallenge/ray.h"
+#include "../RaytracerChallenge/lighttree.h"
+#include "../RaytracerChallenge/sampler.h"
+#include "../RaytracerChallenge/stats.h"
 
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -37,7 +41,7 @@ namespace Tests
 			auto w = World::Default();
 			auto p = Tuple::point(0, 10, 0);
 
-			Assert::AreEqual(false, w.isShadowed(p));
+			Assert::AreEqual(false, w.isShadowed(p, w.lights[0]));
 		}
 
 		TEST_METHOD(TestObjectBetweenPointAndLight)
@@ -45,7 +49,7 @@ namespace Tests
 			auto w = World::Default();
 			auto p = Tuple::point(10, -10, 10);
 
-			Assert::AreEqual(true, w.isShadowed(p));
+			Assert::AreEqual(true, w.isShadowed(p, w.lights[0]));
 		}
 
 		TEST_METHOD(TestObjectBehindLight)
@@ -53,7 +57,7 @@ namespace Tests
 			auto w = World::Default();
 			auto p = Tuple::point(-20, 20, -20);
 
-			Assert::AreEqual(false, w.isShadowed(p));
+			Assert::AreEqual(false, w.isShadowed(p, w.lights[0]));
 		}
 
 		TEST_METHOD(TestObjectBehindPoint)
@@ -61,13 +65,13 @@ namespace Tests
 			auto w = World::Default();
 			auto p = Tuple::point(-2, 2, -2);
 
-			Assert::AreEqual(false, w.isShadowed(p));
+			Assert::AreEqual(false, w.isShadowed(p, w.lights[0]));
 		}
 
 		TEST_METHOD(TestShadeInShadow)
 		{
 			auto w = World();
-			w.light = PointLight(Tuple::point(0, 0, -10), Color(1, 1, 1));
+			w.lights = { PointLight(Tuple::point(0, 0, -10), Color(1, 1, 1)) };
 
 			auto s1 = Sphere();
 			w.addObject(&s1);
@@ -84,6 +88,45 @@ namespace Tests
 			Assert::AreEqual(Color(0.1, 0.1, 0.1), c);
 		}
 
+		TEST_METHOD(TestShadeSumsLights)
+		{
+			auto w = World();
+			w.lights = { PointLight(Tuple::point(0, 0, -10), Color(1, 1, 1)), PointLight(Tuple::point(0, 0, 20), Color(1, 1, 1)) };
+
+			auto s1 = Sphere();
+			w.addObject(&s1);
+
+			auto s2 = Sphere();
+			s2.transform = translation(0, 0, 10);
+
+			auto r = Ray(Tuple::point(0, 0, 5), Tuple::vector(0, 0, 1));
+			auto i = Intersection(4, &s2);
+
+			auto comps = i.prepare(r);
+			auto c = comps.shade(w, 5);
+
+			// both lights add ambient, the second one is on the far side of the sphere
+			Assert::AreEqual(Color(0.2, 0.2, 0.2), c);
+		}
+
+		TEST_METHOD(TestShadeCullsFaintLight)
+		{
+			auto w = World();
+			auto light = PointLight(Tuple::point(0, 0, -10), Color(1, 1, 1));
+			light.quadraticAttenuation = 1000.f;
+			w.lights = { light };
+			w.setLightThreshold(0.01f);
+
+			auto s = Sphere();
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+			auto i = Intersection(4, &s);
+
+			auto comps = i.prepare(r);
+			auto c = comps.shade(w, 5);
+
+			Assert::AreEqual(Color(0.1, 0.1, 0.1), c);
+		}
+
 		TEST_METHOD(TestHitOffsetPoint)
 		{
 			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
@@ -96,6 +139,334 @@ namespace Tests
 			Assert::IsTrue(comps.point.z > comps.overPoint.z);
 		}
 
+		TEST_METHOD(TestRayLeavingConvexShapeSkipsIt)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+
+			auto comps = Intersection(4, &s).prepare(r);
+			auto xs = w.intersect(comps.spawnRay(Tuple::vector(0, 0, -1)));
+
+			Assert::AreEqual(0ull, xs.count());
+		}
+
+		TEST_METHOD(TestRayEnteringClosedShapeHitsFarSide)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+
+			auto comps = Intersection(4, &s).prepare(r);
+			auto xs = w.intersect(comps.spawnRay(Tuple::vector(0, 0, 1)));
+
+			// the entry stays behind the origin for the refractive indices
+			Assert::AreEqual(2ull, xs.count());
+			Assert::IsTrue(xs[0].t <= 0.f);
+			Assert::AreEqual(2.f, xs.hit()->t, 2 * EPSILON);
+		}
+
+		TEST_METHOD(TestRefractedRayLeavesGlassSphere)
+		{
+			auto w = World();
+			auto s = Sphere::glass();
+			w.addObject(&s);
+			auto r = Ray(Tuple::point(0, 0.3f, -5), Tuple::vector(0, 0, 1));
+
+			auto xs = w.intersect(r);
+			auto entry = xs.hit()->prepare(r, xs);
+			Assert::AreEqual(1.f, entry.n1);
+			Assert::AreEqual(1.5f, entry.n2);
+
+			std::vector<PendingRay> rays;
+			entry.spawn(1.f, 5, rays);
+			Assert::AreEqual(1ull, rays.size());
+			auto inside = rays[0].ray;
+			auto insideXs = w.intersect(inside);
+			auto exit = insideXs.hit()->prepare(inside, insideXs);
+			Assert::IsTrue(exit.inside);
+			Assert::AreEqual(1.5f, exit.n1);
+			Assert::AreEqual(1.f, exit.n2);
+		}
+
+		TEST_METHOD(TestHugeSphereNotSelfShadowed)
+		{
+			// far beyond the scale where a fixed EPSILON offset keeps the shadow ray off the surface
+			auto w = World();
+			auto s = Sphere();
+			s.transform = translation(0, -100000, 0) * scaling(100000);
+			w.addObject(&s);
+			auto light = PointLight(Tuple::point(2990, 10, -4990), Color(1, 1, 1));
+
+			auto r = Ray(Tuple::point(3000, 1, -5000), Tuple::vector(0, -1, 0));
+			auto xs = w.intersect(r);
+			auto comps = xs.hit()->prepare(r, xs);
+
+			Assert::AreEqual(1.f, w.visibility(comps, light));
+		}
+	};
+
+	TEST_CLASS(LightTreeTests)
+	{
+	public:
 
+		TEST_METHOD(TestCollectSkipsLightsBelowSurface)
+		{
+			auto lights = std::vector<PointLight>();
+			for (int i = 0; i < 8; i++)
+				lights.push_back(PointLight(Tuple::point((float)i, i % 2 == 0 ? 5.f : -5.f, 0), Color(1, 1, 1)));
+			auto tree = LightTree();
+			tree.build(lights);
+
+			auto selected = std::vector<unsigned int>();
+			tree.collect(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0), 0.01f, selected);
+
+			Assert::AreEqual(4ull, selected.size());
+			for (auto index : selected)
+				Assert::IsTrue(lights[index].position.y > 0.f);
+		}
+
+		TEST_METHOD(TestCollectSkipsAttenuatedLights)
+		{
+			auto near = PointLight(Tuple::point(0, 1, 0), Color(1, 1, 1));
+			near.quadraticAttenuation = 1.f;
+			auto far = PointLight(Tuple::point(0, 100, 0), Color(1, 1, 1));
+			far.quadraticAttenuation = 1.f;
+			auto tree = LightTree();
+			tree.build({ near, far });
+
+			auto selected = std::vector<unsigned int>();
+			tree.collect(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0), 0.01f, selected);
+
+			Assert::AreEqual(1ull, selected.size());
+			Assert::AreEqual(0u, selected[0]);
+		}
+
+		TEST_METHOD(TestSampleProbabilities)
+		{
+			auto tree = LightTree();
+			tree.build({ PointLight(Tuple::point(-1, 1, 0), Color(1, 1, 1)), PointLight(Tuple::point(1, 1, 0), Color(3, 3, 3)) });
+
+			float pdf;
+			auto first = tree.sample(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0), 0.1f, pdf);
+			Assert::AreEqual(0, first);
+			Assert::IsTrue(areEqual(0.25f, pdf));
+
+			auto second = tree.sample(Tuple::point(0, 0, 0), Tuple::vector(0, 1, 0), 0.9f, pdf);
+			Assert::AreEqual(1, second);
+			Assert::IsTrue(areEqual(0.75f, pdf));
+		}
+
+		TEST_METHOD(TestSampleChildrenBelowSurface)
+		{
+			// the bounds of both lights are below the surface, the corner (1, 1) of their common bounds is above it
+			auto tree = LightTree();
+			tree.build({ PointLight(Tuple::point(1, -2, 0), Color(1, 1, 1)), PointLight(Tuple::point(-2, 1, 0), Color(1, 1, 1)) });
+
+			float pdf;
+			Assert::AreEqual(-1, tree.sample(Tuple::point(0, 0, 0), Tuple::vector(1, 1, 0), 0.5f, pdf));
+			Assert::AreEqual(0.f, pdf);
+		}
+
+		TEST_METHOD(TestShadeWithLightTreeMatchesLightList)
+		{
+			auto w = World::Default();
+			w.lights.push_back(PointLight(Tuple::point(10, 10, -10), Color(0.5f, 0.5f, 0.5f)));
+			w.lights.push_back(PointLight(Tuple::point(0, -10, 10), Color(0.5f, 0.5f, 0.5f)));
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+
+			auto expected = w.colorAt(r, 5);
+			w.buildLightTree();
+			auto c = w.colorAt(r, 5);
+
+			Assert::AreEqual(expected, c);
+		}
+	};
+
+	TEST_CLASS(AreaLightTests)
+	{
+	public:
+
+		TEST_METHOD(TestRectangleLight)
+		{
+			auto light = AreaLight::rectangle(Tuple::point(0, 0, 0), Tuple::vector(2, 0, 0), Tuple::vector(0, 0, 1), Color(1, 1, 1));
+
+			Assert::AreEqual(Tuple::point(1, 0, 0.5), light.position);
+			Assert::AreEqual(Tuple::point(0, 0, 0), light.pointOn(0, 0, Tuple::point(0, -5, 0)));
+			Assert::AreEqual(Tuple::point(1.5, 0, 0.25), light.pointOn(0.75, 0.25, Tuple::point(0, -5, 0)));
+		}
+
+		TEST_METHOD(TestSphereLightFacesPoint)
+		{
+			auto light = AreaLight::sphere(Tuple::point(0, 5, 0), 2.f, Color(1, 1, 1));
+			auto from = Tuple::point(0, 0, 0);
+
+			for (float u = 0.f; u < 1.f; u += 0.25f)
+				for (float v = 0.f; v < 1.f; v += 0.25f)
+				{
+					auto p = light.pointOn(u, v, from);
+					Assert::IsTrue(length(p - light.position) <= 2.f + EPSILON);
+					Assert::IsTrue(areEqual(5.f, p.y));
+				}
+		}
+
+		TEST_METHOD(TestVisibilityLit)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto light = AreaLight::rectangle(Tuple::point(-2, 5, 0), Tuple::vector(4, 0, 0), Tuple::vector(0, 0, 1), Color(1, 1, 1));
+
+			Assert::AreEqual(1.f, w.visibility(Tuple::point(5, 0, 0), light));
+		}
+
+		TEST_METHOD(TestVisibilityUmbra)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto light = AreaLight::rectangle(Tuple::point(-2, 5, 0), Tuple::vector(4, 0, 0), Tuple::vector(0, 0, 1), Color(1, 1, 1));
+
+			Assert::AreEqual(0.f, w.visibility(Tuple::point(0, -3, 0), light));
+		}
+
+		TEST_METHOD(TestVisibilityPenumbra)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto light = AreaLight::rectangle(Tuple::point(-2, 5, 0), Tuple::vector(4, 0, 0), Tuple::vector(0, 0, 0.01), Color(1, 1, 1));
+
+			auto v = w.visibility(Tuple::point(1.5, -3, 0), light);
+
+			Assert::IsTrue(v > 0.f);
+			Assert::IsTrue(v < 1.f);
+		}
+
+		TEST_METHOD(TestVisibilityFewSamplesSkipsProbes)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto light = AreaLight::rectangle(Tuple::point(-2, 5, 0), Tuple::vector(4, 0, 0), Tuple::vector(0, 0, 0.01), Color(1, 1, 1), 2);
+
+			RenderStats stats;
+			RenderStats::setActive(&stats);
+			auto v = w.visibility(Tuple::point(1.5, -3, 0), light);
+			RenderStats::setActive(nullptr);
+
+			// the 2 x 2 grid is where the probes would go
+			Assert::AreEqual(0.5f, v);
+			Assert::AreEqual(4ull, stats.shadowRays);
+		}
+
+		TEST_METHOD(TestShadeWithAreaLight)
+		{
+			auto w = World();
+			w.areaLights.push_back(AreaLight::rectangle(Tuple::point(-1, -1, -10), Tuple::vector(2, 0, 0), Tuple::vector(0, 2, 0), Color(1, 1, 1)));
+			auto s = Sphere();
+			w.addObject(&s);
+			auto r = Ray(Tuple::point(0, 0, -5), Tuple::vector(0, 0, 1));
+
+			// unobstructed, same as a point light in the center of the rectangle
+			auto expected = Material().lighting(s, PointLight(Tuple::point(0, 0, -10), Color(1, 1, 1)), Tuple::point(0, 0, -1), Tuple::vector(0, 0, -1), Tuple::vector(0, 0, -1), false);
+			auto c = w.colorAt(r, 5);
+
+			Assert::AreEqual(expected, c);
+		}
+	};
+
+	TEST_CLASS(SamplerTests)
+	{
+	public:
+
+		TEST_METHOD(TestSamplesAreDeterministic)
+		{
+			auto stratified = StratifiedSampler();
+			auto halton = HaltonSampler();
+			auto sobol = SobolSampler();
+			auto blueNoise = BlueNoiseSampler();
+			const Sampler* samplers[] = { &Sampler::regular(), &stratified, &halton, &sobol, &blueNoise };
+
+			for (auto sampler : samplers)
+				for (unsigned int i = 0; i < 64; i++)
+				{
+					auto pixel = PixelSample{ i % 7, i / 7, i % 3 };
+					auto a = sampler->get(pixel, Sampler::Light + i, i, 64);
+					auto b = sampler->get(pixel, Sampler::Light + i, i, 64);
+
+					Assert::IsTrue(a.u >= 0.f && a.u < 1.f && a.v >= 0.f && a.v < 1.f);
+					Assert::AreEqual(a.u, b.u);
+					Assert::AreEqual(a.v, b.v);
+				}
+		}
+
+		TEST_METHOD(TestStratification)
+		{
+			auto stratified = StratifiedSampler();
+			auto sobol = SobolSampler();
+			const Sampler* samplers[] = { &stratified, &sobol };
+
+			// 16 samples put one point in every cell of a 4 x 4 grid
+			for (auto sampler : samplers)
+			{
+				bool cells[16] = {};
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					auto sample = sampler->get({ 3, 5, 0 }, Sampler::Pixel, i, 16);
+					cells[(int)(sample.v * 4) * 4 + (int)(sample.u * 4)] = true;
+				}
+				for (bool cell : cells)
+					Assert::IsTrue(cell);
+			}
+		}
+
+		TEST_METHOD(TestSamplesDifferPerPixelAndDimension)
+		{
+			auto halton = HaltonSampler();
+
+			auto a = halton.get({ 0, 0, 0 }, Sampler::Pixel, 1, 4);
+			auto b = halton.get({ 1, 0, 0 }, Sampler::Pixel, 1, 4);
+			auto c = halton.get({ 0, 0, 0 }, Sampler::Light, 1, 4);
+
+			Assert::IsTrue(a.u != b.u || a.v != b.v);
+			Assert::IsTrue(a.u != c.u || a.v != c.v);
+		}
+
+		TEST_METHOD(TestBlueNoiseMaskRanksEveryPixel)
+		{
+			auto blueNoise = BlueNoiseSampler();
+
+			std::vector<float> values;
+			for (unsigned int y = 0; y < 64; y++)
+				for (unsigned int x = 0; x < 64; x++)
+					values.push_back(blueNoise.maskAt(x, y));
+			std::sort(values.begin(), values.end());
+
+			for (size_t i = 0; i < values.size(); i++)
+				Assert::AreEqual((i + 0.5f) / values.size(), values[i]);
+			Assert::AreEqual(blueNoise.maskAt(3, 5), blueNoise.maskAt(67, 69));
+		}
+
+		TEST_METHOD(TestVisibilityPenumbraWithSampler)
+		{
+			auto w = World();
+			auto s = Sphere();
+			w.addObject(&s);
+			auto sobol = SobolSampler();
+			w.setSampler(&sobol);
+			auto light = AreaLight::rectangle(Tuple::point(-2, 5, 0), Tuple::vector(4, 0, 0), Tuple::vector(0, 0, 0.01), Color(1, 1, 1));
+
+			Sampler::setCurrent({ 2, 3, 0 });
+			auto v = w.visibility(Tuple::point(1.5, -3, 0), light);
+			auto again = w.visibility(Tuple::point(1.5, -3, 0), light);
+			Sampler::setCurrent({ 0, 0, 0 });
+
+			Assert::IsTrue(v > 0.f);
+			Assert::IsTrue(v < 1.f);
+			Assert::AreEqual(v, again);
+		}
 	};
 }
\ No newline at end of file
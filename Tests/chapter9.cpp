@@ -37,7 +37,7 @@ namespace Tests
 		{
 			auto s = TestShape();
 
-			Assert::AreEqual(Matrix<4, 4>::identity(), s.transform);
+			Assert::AreEqual<Matrix<4, 4>>(Matrix<4, 4>::identity(), s.transform);
 		}
 
 		TEST_METHOD(TestAssignTransformation)
@@ -46,14 +46,33 @@ namespace Tests
 
 			s.transform = translation(2, 3, 4);
 
-			Assert::AreEqual(translation(2, 3, 4), s.transform);
+			Assert::AreEqual<Matrix<4, 4>>(translation(2, 3, 4), s.transform);
+		}
+
+		TEST_METHOD(TestShapeBounds)
+		{
+			auto s = Sphere();
+			s.transform = translation(1, 2, 3) * scaling(2, 2, 2);
+			auto b = s.bounds();
+			Assert::AreEqual(Tuple::point(-1, 0, 1), b.min);
+			Assert::AreEqual(Tuple::point(3, 4, 5), b.max);
+
+			// unknown and infinite shapes are everywhere
+			Assert::IsTrue(std::isinf(TestShape().bounds().max.x));
+			auto p = Plane();
+			p.transform = rotationX(0.5f);
+			Assert::IsTrue(std::isinf(p.bounds().min.y));
+
+			Assert::IsTrue(Bounds().isEmpty());
+			Assert::IsTrue(b.overlaps(Bounds(Tuple::point(3, 4, 5), Tuple::point(6, 6, 6))));
+			Assert::IsFalse(b.overlaps(Bounds(Tuple::point(3.5f, 4, 5), Tuple::point(6, 6, 6))));
 		}
 
 		TEST_METHOD(TestDefaultMaterial)
 		{
 			auto s = TestShape();
 
-			auto m = s.material;
+			Material m = s.material;
 
 			Assert::AreEqual(Material(), m);
 		}
@@ -66,7 +85,7 @@ namespace Tests
 
 			s.material = m;
 
-			Assert::AreEqual(m, s.material);
+			Assert::AreEqual(m, *s.material);
 		}
 
 		TEST_METHOD(TestIntersectScaled)
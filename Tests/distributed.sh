@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+# Renders a frame with a coordinator and several worker processes on this host, once with one worker killed
+# mid-frame and once with one stopped past the tile timeout. Both frames must be identical to the one rendered by
+# a single worker.
+#
+# usage: Tests/distributed.sh [path to RaytracerChallenge]
+
+set -u
+renderer=${1:-build/RaytracerChallenge}
+job=(--scene worldRefraction --size 1280x640 --tile 16 --samples 16)
+work=$(mktemp -d)
+pids=()
+
+cleanup()
+{
+	for pid in "${pids[@]}"; do
+		kill -CONT "$pid" 2>/dev/null
+		kill -KILL "$pid" 2>/dev/null
+	done
+	wait 2>/dev/null
+	rm -rf "$work"
+}
+trap cleanup EXIT
+
+fail()
+{
+	echo "FAIL: $*" >&2
+	exit 1
+}
+
+# starts a coordinator writing to $1 and sets port and coordinator to it
+startCoordinator()
+{
+	"$renderer" --coordinator "${job[@]}" --output "$1" "${@:2}" > "$work/coordinator.log" 2>&1 &
+	coordinator=$!
+	pids+=("$coordinator")
+	port=""
+	for _ in $(seq 100); do
+		port=$(sed -n 's/^listening on port \([0-9]*\).*/\1/p' "$work/coordinator.log")
+		[ -n "$port" ] && return
+		sleep 0.1
+	done
+	fail "coordinator didn't start: $(cat "$work/coordinator.log")"
+}
+
+# starts $1 workers and puts their pids in workers
+startWorkers()
+{
+	workers=()
+	for _ in $(seq "$1"); do
+		"$renderer" --worker --port "$port" --threads 1 > /dev/null 2>&1 &
+		workers+=("$!")
+		pids+=("$!")
+	done
+}
+
+# waits for the coordinator and checks that the frame in $1 is the reference
+finish()
+{
+	wait "$coordinator" || fail "coordinator failed: $(cat "$work/coordinator.log")"
+	cmp -s "$work/reference.ppm" "$1" || fail "$1 differs from the frame of a single worker"
+}
+
+[ -x "$renderer" ] || fail "$renderer not found, run make first"
+
+echo "reference with 1 worker"
+startCoordinator "$work/reference.ppm"
+startWorkers 1
+wait "$coordinator" || fail "coordinator failed: $(cat "$work/coordinator.log")"
+
+echo "3 workers, one of them killed"
+startCoordinator "$work/killed.ppm"
+startWorkers 3
+sleep 0.5
+kill -0 "$coordinator" 2>/dev/null || fail "the frame was done before a worker could be killed"
+kill -KILL "${workers[1]}" || fail "worker already gone"
+wait "${workers[1]}" 2>/dev/null
+finish "$work/killed.ppm"
+
+echo "3 workers, one of them stopped past the tile timeout"
+startCoordinator "$work/stopped.ppm" --tile-timeout 1000
+startWorkers 3
+sleep 0.5
+kill -0 "$coordinator" 2>/dev/null || fail "the frame was done before a worker could be stopped"
+kill -STOP "${workers[1]}" || fail "worker already gone"
+finish "$work/stopped.ppm"
+
+echo "PASS"